@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+struct Counters
+{
+    uint64_t allocations;
+    uint64_t syscalls;
+};
+
+/**
+ * Reads the process-wide allocation and system call counters maintained by hooks.cpp.
+ *
+ * Allocations are calls to the global operator new. System calls are calls to the libc wrappers interposed by the benchmark binary, made from outside libc
+ * itself (for example, `fopen` counts as one call even though libc may issue several system calls internally).
+ */
+Counters readCounters();
+
+struct Benchmark
+{
+    std::string name;
+    std::function<void(uint64_t iterations)> body;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocations_per_op;
+    double syscalls_per_op;
+};
+
+BenchmarkResult measure(const Benchmark& benchmark, std::chrono::milliseconds min_time);
+
+void registerKernelBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace);
+void registerTickBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace);
+void registerSampleBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace);
+
+/**
+ * Runs a complete driver against a virtual clock through hours of simulated ticks, with logging at info level, and returns non-zero if any of those ticks
+ * allocated after the first simulated hour.
+ */
+int32_t checkZeroAllocation(const std::filesystem::path& workspace);
+
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
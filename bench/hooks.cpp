@@ -0,0 +1,188 @@
+// Counting hooks for the benchmark binary.
+//
+// The global operator new is replaced to count allocations, and the libc system call wrappers used by the driver are interposed to count system calls.
+// Because the executable is linked with exported symbols, calls from shared libraries (libstdc++, libuv, spdlog) resolve to these definitions too.
+// This file deliberately avoids the POSIX headers that declare most of these functions, so that the definitions below do not clash with their prototypes;
+// those that the standard headers declare anyway are defined with their exact prototypes.
+
+#include "bench.hpp"
+
+#include <dlfcn.h>
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<uint64_t> syscall_count(0);
+
+
+Counters readCounters()
+{
+    Counters counters = {};
+    counters.allocations = allocation_count.load(std::memory_order_relaxed);
+    counters.syscalls = syscall_count.load(std::memory_order_relaxed);
+    return counters;
+}
+
+template <typename Function>
+static Function next(Function& cache, const char* name)
+{
+    if (!cache) {
+        cache = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    }
+    return cache;
+}
+
+#define FORWARD(return_type, name, parameters, arguments)                          \
+    extern "C" return_type name parameters                                         \
+    {                                                                              \
+        static return_type(*real) parameters = nullptr;                            \
+        syscall_count.fetch_add(1, std::memory_order_relaxed);                     \
+        return next(real, #name) arguments;                                        \
+    }
+
+FORWARD(int, close, (int fd), (fd))
+FORWARD(long, read, (int fd, void* buffer, size_t count), (fd, buffer, count))
+FORWARD(long, write, (int fd, const void* buffer, size_t count), (fd, buffer, count))
+FORWARD(long, pread, (int fd, void* buffer, size_t count, long offset), (fd, buffer, count, offset))
+FORWARD(long, pread64, (int fd, void* buffer, size_t count, int64_t offset), (fd, buffer, count, offset))
+FORWARD(long, pwrite, (int fd, const void* buffer, size_t count, long offset), (fd, buffer, count, offset))
+FORWARD(long, pwrite64, (int fd, const void* buffer, size_t count, int64_t offset), (fd, buffer, count, offset))
+FORWARD(long, readv, (int fd, const void* iov, int count), (fd, iov, count))
+FORWARD(long, writev, (int fd, const void* iov, int count), (fd, iov, count))
+FORWARD(long, lseek, (int fd, long offset, int whence), (fd, offset, whence))
+FORWARD(int64_t, lseek64, (int fd, int64_t offset, int whence), (fd, offset, whence))
+FORWARD(int, stat, (const char* path, void* buffer), (path, buffer))
+FORWARD(int, stat64, (const char* path, void* buffer), (path, buffer))
+FORWARD(int, lstat, (const char* path, void* buffer), (path, buffer))
+FORWARD(int, lstat64, (const char* path, void* buffer), (path, buffer))
+FORWARD(int, fstat, (int fd, void* buffer), (fd, buffer))
+FORWARD(int, fstat64, (int fd, void* buffer), (fd, buffer))
+FORWARD(int, access, (const char* path, int mode), (path, mode))
+FORWARD(int, rename, (const char* from, const char* to), (from, to))
+FORWARD(int, unlink, (const char* path), (path))
+FORWARD(int, fsync, (int fd), (fd))
+FORWARD(int, nanosleep, (const timespec* duration, timespec* remaining), (duration, remaining))
+FORWARD(int, clock_nanosleep, (clockid_t clock, int flags, const timespec* duration, timespec* remaining), (clock, flags, duration, remaining))
+FORWARD(FILE*, fopen, (const char* __restrict path, const char* __restrict mode), (path, mode))
+FORWARD(FILE*, fopen64, (const char* __restrict path, const char* __restrict mode), (path, mode))
+FORWARD(int, fclose, (FILE * file), (file))
+FORWARD(int, epoll_wait, (int epoll, void* events, int count, int timeout), (epoll, events, count, timeout))
+FORWARD(int, epoll_pwait, (int epoll, void* events, int count, int timeout, const void* mask), (epoll, events, count, timeout, mask))
+
+extern "C" int open(const char* path, int flags, ...)
+{
+    static int (*real)(const char*, int, ...) = nullptr;
+    va_list args;
+    va_start(args, flags);
+    unsigned int mode = va_arg(args, unsigned int);
+    va_end(args);
+
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    return next(real, "open")(path, flags, mode);
+}
+
+extern "C" int open64(const char* path, int flags, ...)
+{
+    static int (*real)(const char*, int, ...) = nullptr;
+    va_list args;
+    va_start(args, flags);
+    unsigned int mode = va_arg(args, unsigned int);
+    va_end(args);
+
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    return next(real, "open64")(path, flags, mode);
+}
+
+extern "C" int openat(int directory, const char* path, int flags, ...)
+{
+    static int (*real)(int, const char*, int, ...) = nullptr;
+    va_list args;
+    va_start(args, flags);
+    unsigned int mode = va_arg(args, unsigned int);
+    va_end(args);
+
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    return next(real, "openat")(directory, path, flags, mode);
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...)
+{
+    static int (*real)(int, unsigned long, ...) = nullptr;
+    va_list args;
+    va_start(args, request);
+    void* argument = va_arg(args, void*);
+    va_end(args);
+
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    return next(real, "ioctl")(fd, request, argument);
+}
+
+// Used for system calls without a libc wrapper, such as io_uring's. Every call passes the full six arguments on, as the kernel ignores those it does not use.
+extern "C" long syscall(long number, ...)
+{
+    static long (*real)(long, ...) = nullptr;
+    va_list args;
+    va_start(args, number);
+    long arguments[6];
+    for (long& argument : arguments) {
+        argument = va_arg(args, long);
+    }
+    va_end(args);
+
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    return next(real, "syscall")(number, arguments[0], arguments[1], arguments[2], arguments[3], arguments[4], arguments[5]);
+}
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t& /* unused */) noexcept
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t /* unused */) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t /* unused */) noexcept
+{
+    std::free(pointer);
+}
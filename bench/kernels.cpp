@@ -0,0 +1,87 @@
+#include "bench.hpp"
+
+#include "fanshim/backend.hpp"
+#include "fanshim/color.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/gpio.hpp"
+#include "fanshim/sensor.hpp"
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+inline constexpr std::array<uint16_t, 4> CHAIN_LENGTHS = {1, 8, 36, 144};
+
+
+static ChannelConfiguration simulatedChannel()
+{
+    ChannelConfiguration channel = {};
+    channel.name = DEFAULT_CHANNEL_NAME;
+    channel.chip = DEFAULT_CHIP_NAME;
+    channel.fan_pin = DEFAULT_FAN_PIN;
+    channel.button_pin = DEFAULT_BUTTON_PIN;
+    channel.clock_pin = DEFAULT_CLOCK_PIN;
+    channel.data_pin = DEFAULT_DATA_PIN;
+    channel.on_threshold = DEFAULT_ON_THRESHOLD;
+    channel.off_threshold = DEFAULT_OFF_THRESHOLD;
+    return channel;
+}
+
+void registerKernelBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace)
+{
+    suite.push_back({"hsv_to_rgb", [](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             RGB rgb = hsvToRGB((i % 100) / 300.0, 1.0, 0.5);
+                             doNotOptimize(rgb);
+                         }
+                     }});
+
+    suite.push_back({"temperature_to_hue", [](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             double hue = temperatureToHue(40.0 + (i % 30), DEFAULT_ON_THRESHOLD, DEFAULT_OFF_THRESHOLD);
+                             doNotOptimize(hue);
+                         }
+                     }});
+
+    // A frame for each chain length, encoded and handed to the simulated transport in one buffer.
+    for (uint16_t led_count : CHAIN_LENGTHS) {
+        ChannelConfiguration channel = simulatedChannel();
+        channel.led_count = led_count;
+        auto gpio = std::make_shared<GPIOInterface>(channel, std::make_unique<SimulatedBackend>());
+        gpio->setBrightness(MAX_BRIGHTNESS);
+        suite.push_back({"apa102_frame_" + std::to_string(led_count), [gpio](uint64_t iterations) {
+                             for (uint64_t i = 0; i < iterations; ++i) {
+                                 gpio->setLED({static_cast<uint8_t>(i), 0x40, 0x80});
+                             }
+                         }});
+    }
+
+    std::filesystem::path sensor = workspace / "temp";
+    std::ofstream(sensor) << "48312\n";
+    suite.push_back({"temperature_read", [sensor](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             double temperature = readTemperature(sensor);
+                             doNotOptimize(temperature);
+                         }
+                     }});
+
+    // A configuration with every kind of item: top-level settings, bands, a filter and channels with their own.
+    std::filesystem::path configuration_file = workspace / "configuration.json";
+    std::ofstream(configuration_file) << R"({"delay": 5, "blink": 2, "breath-brightness": 20, "output-file": "", "force-file": "", "control-socket": "",
+        "status-segment": "", "load-threshold": 50, "min-on-time": 30, "rt-priority": 50, "pwm-frequency": 100,
+        "bands": [{"on-threshold": 55, "off-threshold": 45, "duty": 40}, {"on-threshold": 65, "off-threshold": 55}],
+        "filter": {"median-window": 5, "smoothing": 50, "max-step": 10},
+        "channels": [{"name": "cpu", "fan-pin": 18, "button-pin": 17, "clock-pin": 14, "data-pin": 15, "led-count": 8},
+                     {"name": "case", "fan-pin": 12, "on-threshold": 45, "off-threshold": 40, "sensor": "/sys/class/thermal/thermal_zone1/temp"}]})";
+    suite.push_back({"configuration_load", [configuration_file](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             Configuration configuration(configuration_file);
+                             doNotOptimize(configuration);
+                         }
+                     }});
+}
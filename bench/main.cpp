@@ -0,0 +1,141 @@
+#include "bench.hpp"
+
+#include "fanshim/logger.hpp"
+
+#include <spdlog/fmt/fmt.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+
+inline constexpr std::chrono::milliseconds DEFAULT_MIN_TIME = std::chrono::milliseconds(200);
+inline constexpr uint64_t CALIBRATION_DIVISOR = 10;
+
+
+BenchmarkResult measure(const Benchmark& benchmark, std::chrono::milliseconds min_time)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up caches and any lazily initialized state, then grow the batch until it runs for a fraction of the minimum time.
+    benchmark.body(1);
+
+    uint64_t iterations = 1;
+    std::chrono::nanoseconds elapsed(0);
+    while (elapsed < min_time / CALIBRATION_DIVISOR) {
+        iterations *= 2;
+        auto start = Clock::now();
+        benchmark.body(iterations);
+        elapsed = Clock::now() - start;
+    }
+
+    uint64_t estimate = static_cast<uint64_t>(iterations * (std::chrono::duration<double>(min_time) / elapsed));
+    iterations = std::max<uint64_t>(estimate, 1);
+
+    Counters before = readCounters();
+    auto start = Clock::now();
+    benchmark.body(iterations);
+    auto end = Clock::now();
+    Counters after = readCounters();
+
+    BenchmarkResult result = {};
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.ns_per_op = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    result.allocations_per_op = static_cast<double>(after.allocations - before.allocations) / iterations;
+    result.syscalls_per_op = static_cast<double>(after.syscalls - before.syscalls) / iterations;
+    return result;
+}
+
+static void usage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--json] [--min-time <ms>] [--check-zero-alloc] [filter]\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    bool check_zero_alloc = false;
+    std::chrono::milliseconds min_time = DEFAULT_MIN_TIME;
+    std::string_view filter;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view argument = argv[i];
+        if (argument == "--json") {
+            json = true;
+        }
+        else if (argument == "--check-zero-alloc") {
+            check_zero_alloc = true;
+        }
+        else if (argument == "--min-time" && i + 1 < argc) {
+            min_time = std::chrono::milliseconds(std::stoul(argv[++i]));
+        }
+        else if (argument.rfind("--", 0) == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            filter = argument;
+        }
+    }
+
+    std::error_code ec;
+    char workspace_template[] = "/tmp/fanshim_bench.XXXXXX";
+    if (!mkdtemp(workspace_template)) {
+        perror("Failed to create benchmark workspace");
+        return 1;
+    }
+    std::filesystem::path workspace(workspace_template);
+
+    // The benchmarks must not touch the system log, and warnings such as fan transitions would dominate the measurements.
+    std::string log_file = (workspace / "bench.log").native();
+    setenv("SHIM_LOG_FILE", log_file.c_str(), 1);
+    logger().setLevel(LogLevel::ERROR);
+
+    if (check_zero_alloc) {
+        int32_t result = checkZeroAllocation(workspace);
+        LoggingInterface::flush();
+        std::filesystem::remove_all(workspace, ec);
+        return result;
+    }
+
+    std::vector<Benchmark> suite;
+    registerKernelBenchmarks(suite, workspace);
+    registerTickBenchmarks(suite, workspace);
+    registerSampleBenchmarks(suite, workspace);
+
+    if (!json) {
+        printf("%-32s %14s %14s %14s %14s\n", "benchmark", "iterations", "ns/op", "allocs/op", "syscalls/op");
+    }
+
+    for (const auto& benchmark : suite) {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        BenchmarkResult result = measure(benchmark, min_time);
+        if (json) {
+            fmt::print("{{\"benchmark\":\"{}\",\"iterations\":{},\"ns_per_op\":{:.2f},\"allocs_per_op\":{:.3f},\"syscalls_per_op\":{:.3f}}}\n",
+                       result.name,
+                       result.iterations,
+                       result.ns_per_op,
+                       result.allocations_per_op,
+                       result.syscalls_per_op);
+        }
+        else {
+            fmt::print("{:<32} {:>14} {:>14.2f} {:>14.3f} {:>14.3f}\n", result.name, result.iterations, result.ns_per_op, result.allocations_per_op, result.syscalls_per_op);
+        }
+        fflush(stdout);
+    }
+
+    suite.clear();
+    LoggingInterface::flush();
+    std::filesystem::remove_all(workspace, ec);
+    return 0;
+}
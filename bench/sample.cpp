@@ -0,0 +1,76 @@
+#include "bench.hpp"
+
+#include "fanshim/sampler.hpp"
+
+#include <uv.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+inline constexpr std::array<size_t, 4> INPUT_COUNTS = {1, 4, 16, 64};
+
+
+/**
+ * A sampler over `inputs` sensor files in the benchmark workspace, on its own loop so that a batch can be run to completion.
+ */
+struct SampleFixture
+{
+    SampleFixture(const std::filesystem::path& workspace, size_t inputs, bool use_io_uring) : loop(), sampler(), done(false)
+    {
+        uv_loop_init(&loop);
+        sampler = std::make_unique<AttributeSampler>(&loop, use_io_uring);
+        for (size_t i = 0; i < inputs; ++i) {
+            std::filesystem::path sensor = workspace / ("sample_temp_" + std::to_string(i));
+            std::ofstream(sensor) << 40000 + i * 100 << "\n";
+            sampler->add(sensor);
+        }
+        sampler->onComplete([this]() { done = true; });
+    }
+
+    ~SampleFixture()
+    {
+        sampler->close([this]() { sampler.reset(); });
+        uv_run(&loop, UV_RUN_DEFAULT);
+        uv_loop_close(&loop);
+    }
+
+    /**
+     * Reads every input once, as a driver tick does, and waits for the batch.
+     */
+    void tick()
+    {
+        done = false;
+        sampler->submit();
+        while (!done) {
+            uv_run(&loop, UV_RUN_ONCE);
+        }
+    }
+
+    uv_loop_t loop;
+    std::unique_ptr<AttributeSampler> sampler;
+    bool done;
+};
+
+void registerSampleBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace)
+{
+    // The same inputs read with a pread() each and as one io_uring batch; the io_uring sampler falls back to pread() where it is unavailable, which
+    // `sample_io_uring_*` then reports as the same syscall count.
+    for (bool use_io_uring : {false, true}) {
+        for (size_t inputs : INPUT_COUNTS) {
+            auto fixture = std::make_shared<SampleFixture>(workspace, inputs, use_io_uring);
+            fixture->tick();
+            std::string name = std::string(use_io_uring ? "sample_io_uring_" : "sample_pread_") + std::to_string(inputs);
+            suite.push_back({name, [fixture](uint64_t iterations) {
+                                 for (uint64_t i = 0; i < iterations; ++i) {
+                                     fixture->tick();
+                                 }
+                             }});
+        }
+    }
+}
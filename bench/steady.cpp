@@ -0,0 +1,122 @@
+#include "bench.hpp"
+
+#include "fanshim/backend.hpp"
+#include "fanshim/clock.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/driver.hpp"
+#include "fanshim/logger.hpp"
+
+#include <fcntl.h>
+#include <spdlog/fmt/fmt.h>
+#include <unistd.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+
+inline constexpr std::chrono::milliseconds WARMUP = std::chrono::hours(1);
+inline constexpr std::chrono::milliseconds STEADY_DURATION = std::chrono::hours(6);
+inline constexpr std::chrono::milliseconds TEMPERATURE_STEP = std::chrono::seconds(30);
+inline constexpr uint64_t TEMPERATURE_PERIOD_MS = 20 * 60 * 1000;
+inline constexpr int32_t MIN_MILLIDEGREES = 40000;
+inline constexpr int32_t MAX_MILLIDEGREES = 70000;
+
+
+/**
+ * A triangle wave between MIN_MILLIDEGREES and MAX_MILLIDEGREES, so that every fan switches on and off twice per TEMPERATURE_PERIOD_MS.
+ */
+static int32_t wave(uint64_t now)
+{
+    uint64_t phase = now % TEMPERATURE_PERIOD_MS;
+    uint64_t half = TEMPERATURE_PERIOD_MS / 2;
+    uint64_t rise = phase < half ? phase : TEMPERATURE_PERIOD_MS - phase;
+    return MIN_MILLIDEGREES + static_cast<int32_t>((MAX_MILLIDEGREES - MIN_MILLIDEGREES) * rise / half);
+}
+
+static void writeFakeSystem(const std::filesystem::path& workspace)
+{
+    std::filesystem::create_directories(workspace / "proc");
+    std::ofstream(workspace / "proc" / "stat") << "cpu  100 0 100 1000 0 0 0 0 0 0\ncpu0 100 0 100 1000 0 0 0 0 0 0\n";
+    std::ofstream(workspace / "proc" / "loadavg") << "0.10 0.10 0.10 1/100 1234\n";
+
+    std::filesystem::path cpufreq = workspace / "sys" / "devices" / "system" / "cpu" / "cpu0" / "cpufreq";
+    std::filesystem::create_directories(cpufreq);
+    std::ofstream(cpufreq / "cpuinfo_max_freq") << "1500000\n";
+    std::ofstream(cpufreq / "scaling_max_freq") << "1500000\n";
+    std::ofstream(cpufreq / "scaling_cur_freq") << "600000\n";
+}
+
+int32_t checkZeroAllocation(const std::filesystem::path& workspace)
+{
+    std::filesystem::path sensor = workspace / "steady_temp";
+    std::filesystem::path configuration_file = workspace / "steady.json";
+    writeFakeSystem(workspace);
+    std::ofstream(sensor) << MIN_MILLIDEGREES << "\n";
+    std::ofstream(configuration_file) << "{\"blink\": 2, \"control-socket\": \"\", \"status-segment\": \"\", \"force-file\": \"\", \"load-threshold\": 50, \"reconcile-interval\": 60, "
+                                      << "\"min-on-time\": 30, \"output-file\": \"" << (workspace / "steady.prom").native() << "\", \"proc-root\": \""
+                                      << (workspace / "proc").native() << "\", \"sys-root\": \"" << (workspace / "sys").native()
+                                      << "\", \"channels\": [{\"name\": \"steady\", \"fan-pin\": 18, \"button-pin\": 17, \"clock-pin\": 14, \"data-pin\": 15, \"sensor\": \""
+                                      << sensor.native() << "\"}]}";
+
+    int32_t sensor_fd = ::open(sensor.c_str(), O_WRONLY | O_CLOEXEC);
+    if (sensor_fd < 0) {
+        perror("Failed to open the steady-state sensor");
+        return 1;
+    }
+
+    Configuration configuration(configuration_file);
+    VirtualClock clock;
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    int32_t result = 0;
+    {
+        Driver driver(configuration, &loop, SimulatedBackend::create, &clock);
+
+        // Rewriting the sensor between timer callbacks keeps the fan and LED switching, so every steady-state path runs, including the log lines.
+        auto run = [&](uint64_t until) {
+            char contents[16];
+            while (clock.now() < until) {
+                int32_t length = snprintf(contents, sizeof(contents), "%d\n", wave(clock.now()));
+                if (::pwrite(sensor_fd, contents, length, 0) != length || ::ftruncate(sensor_fd, length) != 0) {
+                    perror("Failed to update the steady-state sensor");
+                }
+                clock.runUntil(std::min<uint64_t>(until, clock.now() + TEMPERATURE_STEP.count()));
+            }
+        };
+
+        logger().setLevel(LogLevel::INFO);
+        driver.start();
+        run(WARMUP.count());
+
+        Counters before = readCounters();
+        uint64_t callbacks = clock.callbacks();
+        uint64_t transitions = driver.channels().front()->stats().fan_transitions;
+        run((WARMUP + STEADY_DURATION).count());
+        Counters after = readCounters();
+        callbacks = clock.callbacks() - callbacks;
+        transitions = driver.channels().front()->stats().fan_transitions - transitions;
+
+        logger().setLevel(LogLevel::ERROR);
+
+        uint64_t allocations = after.allocations - before.allocations;
+        fmt::print("Steady state over {} simulated hours: {} timer callbacks, {} fan transitions, {} allocations\n",
+                   std::chrono::duration_cast<std::chrono::hours>(STEADY_DURATION).count(),
+                   callbacks,
+                   transitions,
+                   allocations);
+        result = allocations == 0 && transitions > 0 ? 0 : 1;
+
+        driver.close(nullptr);
+        uv_run(&loop, UV_RUN_DEFAULT);
+    }
+
+    ::close(sensor_fd);
+    uv_loop_close(&loop);
+    return result;
+}
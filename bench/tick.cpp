@@ -0,0 +1,93 @@
+#include "bench.hpp"
+
+#include "fanshim/backend.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/driver.hpp"
+#include "fanshim/metrics.hpp"
+
+#include <spdlog/fmt/fmt.h>
+#include <uv.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+
+/**
+ * A complete driver running against simulated GPIO, a sensor file and a metrics file in the benchmark workspace.
+ */
+struct TickFixture
+{
+    TickFixture(const std::filesystem::path& workspace) : loop(), configuration(), driver()
+    {
+        std::filesystem::path sensor = workspace / "tick_temp";
+        std::filesystem::path configuration_file = workspace / "tick.json";
+        std::ofstream(sensor) << "48312\n";
+        std::ofstream(configuration_file) << "{\"blink\": 2, \"control-socket\": \"\", \"status-segment\": \"\", \"output-file\": \"" << (workspace / "tick.prom").native()
+                                          << "\", \"channels\": [{\"name\": \"bench\", \"fan-pin\": 18, \"button-pin\": 17, \"clock-pin\": 14, \"data-pin\": 15, \"sensor\": \""
+                                          << sensor.native() << "\"}]}";
+
+        uv_loop_init(&loop);
+        configuration = std::make_unique<Configuration>(configuration_file);
+        driver = std::make_unique<Driver>(*configuration, &loop, SimulatedBackend::create);
+    }
+
+    ~TickFixture()
+    {
+        driver->close(nullptr);
+        uv_run(&loop, UV_RUN_DEFAULT);
+        driver.reset();
+        uv_loop_close(&loop);
+    }
+
+    uv_loop_t loop;
+    std::unique_ptr<Configuration> configuration;
+    std::unique_ptr<Driver> driver;
+};
+
+void registerTickBenchmarks(std::vector<Benchmark>& suite, const std::filesystem::path& workspace)
+{
+    auto fixture = std::make_shared<TickFixture>(workspace);
+    fixture->driver->readTemperatures();
+
+    auto buffer = std::make_shared<fmt::memory_buffer>();
+    suite.push_back({"prom_serialise", [fixture, buffer](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             buffer->clear();
+                             serializeMetrics(*buffer, fixture->driver->channels(), fixture->driver->throttle());
+                         }
+                     }});
+
+    auto metrics = std::make_shared<MetricsFile>(workspace / "bench.prom");
+    suite.push_back({"prom_write", [fixture, metrics](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             metrics->write(fixture->driver->channels(), fixture->driver->throttle());
+                         }
+                     }});
+
+    suite.push_back({"tick_temperature", [fixture](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             fixture->driver->readTemperatures();
+                         }
+                     }});
+
+    suite.push_back({"tick_button", [fixture](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             fixture->driver->checkButtons();
+                         }
+                     }});
+
+    suite.push_back({"tick_override", [fixture](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             fixture->driver->checkOverride();
+                         }
+                     }});
+
+    suite.push_back({"tick_led", [fixture](uint64_t iterations) {
+                         for (uint64_t i = 0; i < iterations; ++i) {
+                             fixture->driver->tickLED();
+                         }
+                     }});
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <uv.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * Fan control for hosting inside another process, such as a node agent, on that process's event loop.
+ *
+ * The controller reads the driver's configuration file and runs every channel's timers on the caller's `uv_loop_t`; the caller keeps running the loop. With
+ * `external_sensors`, the channels never read their sensor files and the caller feeds each reading in with feedTemperature(). Link against the `libfanshim`
+ * target.
+ *
+ * The controller's handles live inside it and are closed by close(), which leaves every other handle on the loop alone. Keep running the loop until the
+ * close callback before destroying the controller.
+ */
+
+struct ControllerOptions
+{
+    std::filesystem::path configuration_file = "/etc/fanshim.json";
+
+    /**
+     * Temperatures come only from feedTemperature(), instead of each channel's sensor file.
+     */
+    bool external_sensors = false;
+
+    /**
+     * Opens the control socket and status segment named in the configuration, as the driver does.
+     */
+    bool serve = false;
+
+    /**
+     * Logs through the host's spdlog default logger instead of the driver's log file. Only takes effect for the first controller in a process.
+     */
+    bool host_logger = true;
+};
+
+struct ControllerStatus
+{
+    /**
+     * NaN until the channel has read a temperature successfully.
+     */
+    double temperature;
+    double raw_temperature;
+    uint8_t duty;
+    bool fan;
+};
+
+class Driver;
+struct Configuration;
+
+class FanController
+{
+public:
+    using CloseCallback = std::function<void()>;
+
+    FanController(uv_loop_t* loop, const ControllerOptions& options = ControllerOptions());
+    ~FanController();
+
+    /**
+     * Arms the channels' timers on the loop.
+     */
+    void start();
+    void stop();
+
+    /**
+     * Stops the controller and closes its handles, calling `callback` on the loop once all of them are closed. Must complete before the controller is
+     * destroyed.
+     */
+    void close(CloseCallback callback);
+
+    std::vector<std::string> channels() const;
+
+    /**
+     * Filters `temperature`, in degrees celsius, and acts on it for `channel`, as if the channel's sensor had returned it. Returns false for an unknown
+     * channel.
+     */
+    bool feedTemperature(std::string_view channel, double temperature);
+
+    /**
+     * Returns false for an unknown channel.
+     */
+    bool status(std::string_view channel, ControllerStatus& status) const;
+
+private:
+    FanController(const FanController&) = delete;
+    FanController(FanController&&) = delete;
+    FanController& operator=(const FanController&) = delete;
+    FanController& operator=(FanController&&) = delete;
+
+    std::unique_ptr<Configuration> _configuration;
+    std::unique_ptr<Driver> _driver;
+    bool _serve;
+};
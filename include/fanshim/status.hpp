@@ -0,0 +1,144 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+ * Layout and reader for the shared-memory status segment published by the Fan SHIM driver.
+ *
+ * This header has no dependencies beyond the C++ standard library and POSIX, so local agents can include it directly. The segment is protected by a
+ * sequence lock: the driver makes the sequence odd while it updates the snapshot and even once the snapshot is consistent, so readers retry instead of
+ * blocking the driver.
+ */
+
+inline constexpr const char* DEFAULT_STATUS_SEGMENT = "/fanshim";
+inline constexpr uint32_t STATUS_MAGIC = 0x53485346; // "FSHS"
+inline constexpr uint32_t STATUS_VERSION = 2;
+inline constexpr size_t STATUS_MAX_CHANNELS = 8;
+inline constexpr size_t STATUS_NAME_SIZE = 16;
+inline constexpr size_t STATUS_READ_ATTEMPTS = 64;
+
+struct StatusChannel
+{
+    char name[STATUS_NAME_SIZE];
+    /**
+     * NaN until the channel has read a temperature successfully.
+     */
+    double temperature;
+    uint64_t temperature_reads;
+    uint64_t fan_transitions;
+    uint8_t fan;
+    uint8_t button;
+    uint8_t override_active;
+    uint8_t temperature_active;
+    uint8_t force;
+    uint8_t reserved[3];
+};
+
+struct StatusSnapshot
+{
+    uint64_t timestamp_ns;
+    uint64_t updates;
+    uint32_t channel_count;
+    uint32_t reserved;
+    StatusChannel channels[STATUS_MAX_CHANNELS];
+};
+
+struct StatusSegment
+{
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    uint32_t size;
+    StatusSnapshot snapshot;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The status sequence must be lock-free to be shared between processes");
+
+class StatusReader
+{
+public:
+    StatusReader() : _segment(nullptr)
+    {}
+
+    ~StatusReader()
+    {
+        close();
+    }
+
+    bool open(const char* name = DEFAULT_STATUS_SEGMENT)
+    {
+        close();
+
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        void* address = mmap(nullptr, sizeof(StatusSegment), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return false;
+        }
+
+        _segment = static_cast<const StatusSegment*>(address);
+        if (_segment->magic != STATUS_MAGIC || _segment->version != STATUS_VERSION || _segment->size != sizeof(StatusSegment)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (_segment) {
+            munmap(const_cast<StatusSegment*>(_segment), sizeof(StatusSegment));
+            _segment = nullptr;
+        }
+    }
+
+    bool isOpen() const
+    {
+        return _segment != nullptr;
+    }
+
+    /**
+     * Copies a consistent snapshot out of the segment. Returns false if the driver was updating the segment for every attempt.
+     */
+    bool read(StatusSnapshot& snapshot) const
+    {
+        if (!_segment) {
+            return false;
+        }
+
+        for (size_t attempt = 0; attempt < STATUS_READ_ATTEMPTS; ++attempt) {
+            uint32_t before = _segment->sequence.load(std::memory_order_acquire);
+            if (before & 1U) {
+                continue;
+            }
+
+            std::memcpy(&snapshot, &_segment->snapshot, sizeof(StatusSnapshot));
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (_segment->sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    StatusReader(const StatusReader&) = delete;
+    StatusReader(StatusReader&&) = delete;
+    StatusReader& operator=(const StatusReader&) = delete;
+    StatusReader& operator=(StatusReader&&) = delete;
+
+    const StatusSegment* _segment;
+};
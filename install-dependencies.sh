@@ -8,4 +8,4 @@ cmake --build build
 sudo cmake --install build
 
 sudo apt update
-sudo apt install libgpiod-dev libuv1-dev libspdlog-dev
+sudo apt install libgpiod-dev libuv1-dev libspdlog-dev zlib1g-dev
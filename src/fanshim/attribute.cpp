@@ -0,0 +1,79 @@
+#include "fanshim/attribute.hpp"
+
+#include "fanshim/logger.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+
+inline constexpr size_t INTEGER_BUFFER_SIZE = 32;
+
+
+int32_t openAttribute(const std::filesystem::path& path)
+{
+    int32_t fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        logger().error("Failed to open {}: {}", path.native(), strerror(errno));
+        return NO_FD;
+    }
+    return fd;
+}
+
+bool readAttribute(int32_t fd, char* buffer, size_t size)
+{
+    ssize_t length = ::pread(fd, buffer, size - 1, 0);
+    if (length <= 0) {
+        return false;
+    }
+    buffer[length] = '\0';
+    return true;
+}
+
+bool readAttribute(int32_t fd, uint64_t& value)
+{
+    char buffer[INTEGER_BUFFER_SIZE];
+    if (!readAttribute(fd, buffer, sizeof(buffer))) {
+        return false;
+    }
+
+    char* end = nullptr;
+    uint64_t parsed = std::strtoull(buffer, &end, 10);
+    if (end == buffer) {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+bool readAttribute(int32_t fd, int64_t& value)
+{
+    char buffer[INTEGER_BUFFER_SIZE];
+    return readAttribute(fd, buffer, sizeof(buffer)) && parseAttribute(buffer, value);
+}
+
+bool parseAttribute(const char* buffer, int64_t& value)
+{
+    char* end = nullptr;
+    int64_t parsed = std::strtoll(buffer, &end, 10);
+    if (end == buffer) {
+        return false;
+    }
+
+    value = parsed;
+    return true;
+}
+
+void closeAttribute(int32_t& fd)
+{
+    if (fd >= 0) {
+        ::close(fd);
+        fd = NO_FD;
+    }
+}
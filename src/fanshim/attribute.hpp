@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+
+inline constexpr int32_t NO_FD = -1;
+
+/**
+ * Opens a procfs or sysfs file for repeated reads, logging on failure. Returns NO_FD if it cannot be opened.
+ */
+int32_t openAttribute(const std::filesystem::path& path);
+
+/**
+ * Reads an attribute from the start into `buffer` and null-terminates it. Kernel attributes are regenerated on every read from offset 0, so one descriptor
+ * serves every sample.
+ */
+bool readAttribute(int32_t fd, char* buffer, size_t size);
+
+/**
+ * Reads a single unsigned integer attribute.
+ */
+bool readAttribute(int32_t fd, uint64_t& value);
+bool readAttribute(int32_t fd, int64_t& value);
+
+/**
+ * Parses an integer attribute already read into `buffer`, for reads that were not issued through readAttribute().
+ */
+bool parseAttribute(const char* buffer, int64_t& value);
+
+void closeAttribute(int32_t& fd);
@@ -0,0 +1,245 @@
+#include "fanshim/backend.hpp"
+
+#include "fanshim/logger.hpp"
+
+#include <gpiod.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+
+inline constexpr std::string_view CONSUMER_NAME = "fanshim";
+inline constexpr std::chrono::microseconds CLOCK_STRETCH = std::chrono::microseconds(5);
+
+
+static size_t index(Line line)
+{
+    return static_cast<size_t>(line);
+}
+
+static uint8_t bitAt(const uint8_t* data, size_t bit)
+{
+    return (data[bit / __CHAR_BIT__] >> (__CHAR_BIT__ - 1 - bit % __CHAR_BIT__)) & 0x01;
+}
+
+void GPIOBackend::shiftOut(const uint8_t* data, size_t bits)
+{
+    for (size_t i = 0; i < bits; ++i) {
+        write(Line::LED_DATA, bitAt(data, i));
+        write(Line::LED_CLOCK, 1);
+        stretchClock();
+        write(Line::LED_CLOCK, 0);
+        stretchClock();
+    }
+}
+
+GpiodBackend::GpiodBackend(const ChannelConfiguration& configuration)
+    : _chip(configuration.chip, gpiod::chip::OPEN_BY_NAME), _lines(), _requested()
+{
+    gpiod::line_request write_request;
+    write_request.consumer = CONSUMER_NAME;
+    write_request.request_type = gpiod::line_request::DIRECTION_OUTPUT;
+    write_request.flags = 0;
+
+    gpiod::line_request read_request;
+    read_request.consumer = CONSUMER_NAME;
+    read_request.request_type = gpiod::line_request::DIRECTION_INPUT;
+    read_request.flags = 0;
+
+    _lines[index(Line::FAN)] = _chip.get_line(configuration.fan_pin);
+    _lines[index(Line::FAN)].request(write_request, 0);
+    _requested[index(Line::FAN)] = true;
+
+    if (configuration.button_pin != NO_PIN) {
+        _lines[index(Line::BUTTON)] = _chip.get_line(configuration.button_pin);
+        _lines[index(Line::BUTTON)].request(read_request);
+        _requested[index(Line::BUTTON)] = true;
+    }
+
+    if (configuration.clock_pin != NO_PIN && configuration.data_pin != NO_PIN) {
+        _lines[index(Line::LED_CLOCK)] = _chip.get_line(configuration.clock_pin);
+        _lines[index(Line::LED_CLOCK)].request(write_request, 0);
+        _requested[index(Line::LED_CLOCK)] = true;
+
+        _lines[index(Line::LED_DATA)] = _chip.get_line(configuration.data_pin);
+        _lines[index(Line::LED_DATA)].request(write_request, 0);
+        _requested[index(Line::LED_DATA)] = true;
+    }
+}
+
+GpiodBackend::~GpiodBackend()
+{
+    for (size_t i = 0; i < LINE_COUNT; ++i) {
+        if (_requested[i]) {
+            _lines[i].release();
+        }
+    }
+}
+
+std::unique_ptr<GPIOBackend> GpiodBackend::create(const ChannelConfiguration& configuration)
+{
+    return std::make_unique<GpiodBackend>(configuration);
+}
+
+uint8_t GpiodBackend::read(Line line) const
+{
+    return _lines[index(line)].get_value();
+}
+
+void GpiodBackend::write(Line line, uint8_t value)
+{
+    _lines[index(line)].set_value(value);
+}
+
+void GpiodBackend::stretchClock()
+{
+    std::this_thread::sleep_for(CLOCK_STRETCH);
+}
+
+void GpiodBackend::shiftOut(const uint8_t* data, size_t bits)
+{
+    gpiod::line& data_line = _lines[index(Line::LED_DATA)];
+    gpiod::line& clock_line = _lines[index(Line::LED_CLOCK)];
+
+    // The data line only needs writing when the bit changes, which skips most of the start frame, end frame and the leading bits of each LED word.
+    int32_t level = -1;
+    for (size_t i = 0; i < bits; ++i) {
+        int32_t bit = bitAt(data, i);
+        if (bit != level) {
+            data_line.set_value(bit);
+            level = bit;
+        }
+        clock_line.set_value(1);
+        std::this_thread::sleep_for(CLOCK_STRETCH);
+        clock_line.set_value(0);
+        std::this_thread::sleep_for(CLOCK_STRETCH);
+    }
+}
+
+ShadowBackend::ShadowBackend(const ChannelConfiguration& configuration, std::unique_ptr<GPIOBackend> backend)
+    : _backend(std::move(backend)), _values(), _outputs(), _stats()
+{
+    // Output lines are requested low, so the shadow starts out matching them.
+    bool has_led = configuration.clock_pin != NO_PIN && configuration.data_pin != NO_PIN;
+    _outputs[index(Line::FAN)] = true;
+    _outputs[index(Line::LED_CLOCK)] = has_led;
+    _outputs[index(Line::LED_DATA)] = has_led;
+}
+
+uint8_t ShadowBackend::read(Line line) const
+{
+    if (!_outputs[index(line)]) {
+        return _backend->read(line);
+    }
+
+    _stats.reads_saved++;
+    return _values[index(line)];
+}
+
+void ShadowBackend::write(Line line, uint8_t value)
+{
+    _backend->write(line, value);
+    _values[index(line)] = value ? 1 : 0;
+}
+
+void ShadowBackend::stretchClock()
+{
+    _backend->stretchClock();
+}
+
+void ShadowBackend::shiftOut(const uint8_t* data, size_t bits)
+{
+    _backend->shiftOut(data, bits);
+    if (bits > 0) {
+        _values[index(Line::LED_DATA)] = bitAt(data, bits - 1);
+        _values[index(Line::LED_CLOCK)] = 0;
+    }
+}
+
+uint32_t ShadowBackend::reconcile()
+{
+    _stats.reconciliations++;
+
+    uint32_t mismatches = 0;
+    for (size_t i = 0; i < LINE_COUNT; ++i) {
+        if (!_outputs[i]) {
+            continue;
+        }
+
+        uint8_t actual = _backend->read(static_cast<Line>(i)) ? 1 : 0;
+        if (actual != _values[i]) {
+            logger().warn("GPIO line {} changed outside the driver, expected {} but read {}", i, _values[i], actual);
+            _values[i] = actual;
+            mismatches++;
+        }
+    }
+
+    _stats.mismatches += mismatches;
+    return mismatches;
+}
+
+const ShadowStats& ShadowBackend::stats() const
+{
+    return _stats;
+}
+
+SimulatedBackend::SimulatedBackend() : _values(), _reads(0), _writes(0), _shifted_bits(0)
+{}
+
+std::unique_ptr<GPIOBackend> SimulatedBackend::create(const ChannelConfiguration& /* unused */)
+{
+    return std::make_unique<SimulatedBackend>();
+}
+
+uint8_t SimulatedBackend::read(Line line) const
+{
+    _reads++;
+    return _values[index(line)];
+}
+
+void SimulatedBackend::write(Line line, uint8_t value)
+{
+    _writes++;
+    _values[index(line)] = value ? 1 : 0;
+}
+
+void SimulatedBackend::stretchClock()
+{}
+
+void SimulatedBackend::shiftOut(const uint8_t* data, size_t bits)
+{
+    if (bits == 0) {
+        return;
+    }
+
+    // Each bit costs a data write and two clock writes when bit-banged.
+    _writes += 3 * bits;
+    _shifted_bits += bits;
+    _values[index(Line::LED_DATA)] = bitAt(data, bits - 1);
+    _values[index(Line::LED_CLOCK)] = 0;
+}
+
+void SimulatedBackend::setInput(Line line, uint8_t value)
+{
+    _values[index(line)] = value ? 1 : 0;
+}
+
+uint64_t SimulatedBackend::reads() const
+{
+    return _reads;
+}
+
+uint64_t SimulatedBackend::writes() const
+{
+    return _writes;
+}
+
+uint64_t SimulatedBackend::shiftedBits() const
+{
+    return _shifted_bits;
+}
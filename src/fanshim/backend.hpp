@@ -0,0 +1,144 @@
+#pragma once
+
+#include "fanshim/configuration.hpp"
+
+#include <gpiod.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+enum class Line : uint8_t
+{
+    FAN = 0,
+    BUTTON = 1,
+    LED_CLOCK = 2,
+    LED_DATA = 3
+};
+
+inline constexpr size_t LINE_COUNT = 4;
+
+/**
+ * The transport that the GPIOInterface drives its lines through.
+ */
+class GPIOBackend
+{
+public:
+    using Factory = std::unique_ptr<GPIOBackend> (*)(const ChannelConfiguration& configuration);
+
+    virtual ~GPIOBackend() = default;
+
+    virtual uint8_t read(Line line) const = 0;
+    virtual void write(Line line, uint8_t value) = 0;
+
+    /**
+     * Holds the LED clock line in its current state for long enough for the LED to latch it.
+     */
+    virtual void stretchClock() = 0;
+
+    /**
+     * Clocks the first `bits` bits of `data`, most significant bit first, out on the LED data line. By default each bit is written with write() and
+     * stretchClock(); transports that can move whole buffers override this.
+     */
+    virtual void shiftOut(const uint8_t* data, size_t bits);
+};
+
+/**
+ * Drives the lines of a real GPIO chip through libgpiod.
+ */
+class GpiodBackend : public GPIOBackend
+{
+public:
+    GpiodBackend(const ChannelConfiguration& configuration);
+    ~GpiodBackend() override;
+
+    static std::unique_ptr<GPIOBackend> create(const ChannelConfiguration& configuration);
+
+    uint8_t read(Line line) const override;
+    void write(Line line, uint8_t value) override;
+    void stretchClock() override;
+    void shiftOut(const uint8_t* data, size_t bits) override;
+
+private:
+    GpiodBackend(const GpiodBackend&) = delete;
+    GpiodBackend(GpiodBackend&&) = delete;
+    GpiodBackend& operator=(const GpiodBackend&) = delete;
+    GpiodBackend& operator=(GpiodBackend&&) = delete;
+
+    gpiod::chip _chip;
+    std::array<gpiod::line, LINE_COUNT> _lines;
+    std::array<bool, LINE_COUNT> _requested;
+};
+
+struct ShadowStats
+{
+    uint64_t reads_saved;
+    uint64_t reconciliations;
+    uint64_t mismatches;
+};
+
+/**
+ * Remembers the last value written to each output line and answers reads of it from memory, so that only the button costs a kernel round-trip.
+ *
+ * Nothing else should drive the lines, but if something does, reconcile() reads the real values back and adopts them.
+ */
+class ShadowBackend : public GPIOBackend
+{
+public:
+    ShadowBackend(const ChannelConfiguration& configuration, std::unique_ptr<GPIOBackend> backend);
+
+    uint8_t read(Line line) const override;
+    void write(Line line, uint8_t value) override;
+    void stretchClock() override;
+    void shiftOut(const uint8_t* data, size_t bits) override;
+
+    /**
+     * Returns the number of output lines whose real value differed from the shadow.
+     */
+    uint32_t reconcile();
+    const ShadowStats& stats() const;
+
+private:
+    ShadowBackend(const ShadowBackend&) = delete;
+    ShadowBackend(ShadowBackend&&) = delete;
+    ShadowBackend& operator=(const ShadowBackend&) = delete;
+    ShadowBackend& operator=(ShadowBackend&&) = delete;
+
+    std::unique_ptr<GPIOBackend> _backend;
+    std::array<uint8_t, LINE_COUNT> _values;
+    std::array<bool, LINE_COUNT> _outputs;
+    mutable ShadowStats _stats;
+};
+
+/**
+ * Keeps line values in memory, for benchmarking and simulating the driver without hardware.
+ */
+class SimulatedBackend : public GPIOBackend
+{
+public:
+    SimulatedBackend();
+
+    static std::unique_ptr<GPIOBackend> create(const ChannelConfiguration& configuration);
+
+    uint8_t read(Line line) const override;
+    void write(Line line, uint8_t value) override;
+    void stretchClock() override;
+
+    /**
+     * Takes the whole buffer at once, as an SPI transport would, leaving the lines as bit-banging it would have.
+     */
+    void shiftOut(const uint8_t* data, size_t bits) override;
+
+    void setInput(Line line, uint8_t value);
+    uint64_t reads() const;
+    uint64_t writes() const;
+    uint64_t shiftedBits() const;
+
+private:
+    std::array<uint8_t, LINE_COUNT> _values;
+    mutable uint64_t _reads;
+    uint64_t _writes;
+    uint64_t _shifted_bits;
+};
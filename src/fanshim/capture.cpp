@@ -0,0 +1,203 @@
+#include "fanshim/capture.hpp"
+
+#include "fanshim/logger.hpp"
+
+#include <spdlog/fmt/fmt.h>
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+
+inline constexpr uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+inline constexpr uint64_t FRAME_GAP_NS = 1000000;
+inline constexpr std::array<std::string_view, LINE_COUNT> LINE_NAMES = {"fan", "button", "led_clock", "led_data"};
+inline constexpr std::array<char, LINE_COUNT> VCD_IDENTIFIERS = {'!', '"', '#', '$'};
+inline constexpr size_t MAX_INPUT_TRANSITIONS = 4096;
+inline constexpr uint8_t UNKNOWN_LEVEL = 0xFF;
+
+
+static uint64_t monotonicNow()
+{
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+static size_t index(Line line)
+{
+    return static_cast<size_t>(line);
+}
+
+
+CaptureBackend::CaptureBackend(std::unique_ptr<GPIOBackend> backend, size_t capacity)
+    : _backend(std::move(backend)),
+      _transitions(capacity),
+      _size(0),
+      _inputs(std::min(capacity, MAX_INPUT_TRANSITIONS)),
+      _input_size(0),
+      _dropped(0),
+      _levels(),
+      _button_level(UNKNOWN_LEVEL),
+      _start_ns(monotonicNow())
+{}
+
+uint8_t CaptureBackend::read(Line line) const
+{
+    uint8_t value = _backend->read(line);
+
+    // The button is only ever read, so its level is whatever was last read, and unknown until the first read.
+    uint8_t level = value ? 1 : 0;
+    if (line == Line::BUTTON && level != _button_level) {
+        _button_level = level;
+        _record(_inputs, _input_size, line, level);
+    }
+    return value;
+}
+
+void CaptureBackend::write(Line line, uint8_t value)
+{
+    _backend->write(line, value);
+
+    // Lines are requested low, and a write that does not change the level is not a transition.
+    uint8_t level = value ? 1 : 0;
+    if (_levels[index(line)] == level) {
+        return;
+    }
+    _levels[index(line)] = level;
+    _record(_transitions, _size, line, level);
+}
+
+void CaptureBackend::stretchClock()
+{
+    _backend->stretchClock();
+}
+
+void CaptureBackend::shiftOut(const uint8_t* data, size_t bits)
+{
+    GPIOBackend::shiftOut(data, bits);
+}
+
+size_t CaptureBackend::size() const
+{
+    return _size.load(std::memory_order_acquire) + _input_size.load(std::memory_order_acquire);
+}
+
+uint64_t CaptureBackend::dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+CaptureTiming CaptureBackend::timing() const
+{
+    CaptureTiming timing = {};
+    size_t size = _size.load(std::memory_order_acquire);
+
+    uint64_t previous = 0;
+    uint64_t frame_start = 0;
+    uint64_t periods = 0;
+    uint64_t frame_total = 0;
+    double period_total = 0.0;
+    double period_squares = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        const Transition& transition = _transitions[i];
+        if (transition.line != Line::LED_CLOCK || transition.value == 0) {
+            continue;
+        }
+
+        uint64_t now = transition.time_ns;
+        if (timing.clock_edges == 0 || now - previous > FRAME_GAP_NS) {
+            if (timing.clock_edges > 0) {
+                frame_total += previous - frame_start;
+            }
+            frame_start = now;
+            timing.frames++;
+        }
+        else {
+            uint64_t period = now - previous;
+            timing.min_period_ns = periods == 0 ? period : std::min(timing.min_period_ns, period);
+            timing.max_period_ns = std::max(timing.max_period_ns, period);
+            period_total += period;
+            period_squares += static_cast<double>(period) * period;
+            periods++;
+        }
+
+        timing.clock_edges++;
+        previous = now;
+    }
+
+    if (timing.clock_edges > 0) {
+        frame_total += previous - frame_start;
+        timing.mean_frame_ns = frame_total / timing.frames;
+    }
+
+    if (periods > 0) {
+        double mean = period_total / periods;
+        timing.mean_period_ns = static_cast<uint64_t>(mean);
+        timing.jitter_ns = static_cast<uint64_t>(std::sqrt(std::max(0.0, period_squares / periods - mean * mean)));
+    }
+    return timing;
+}
+
+bool CaptureBackend::writeVCD(const std::filesystem::path& path, std::string_view name) const
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        logger().error("Failed to open capture file {}: {}", path.native(), strerror(errno));
+        return false;
+    }
+
+    fmt::print(file, "$version fanshim $end\n$timescale 1ns $end\n$scope module {} $end\n", name);
+    for (size_t i = 0; i < LINE_COUNT; ++i) {
+        fmt::print(file, "$var wire 1 {} {} $end\n", VCD_IDENTIFIERS[i], LINE_NAMES[i]);
+    }
+    fmt::print(file, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+    for (size_t i = 0; i < LINE_COUNT; ++i) {
+        fmt::print(file, "{}{}\n", static_cast<Line>(i) == Line::BUTTON ? 'x' : '0', VCD_IDENTIFIERS[i]);
+    }
+    fmt::print(file, "$end\n");
+
+    // Both buffers are in time order, so merging them keeps the dump in time order.
+    size_t outputs = _size.load(std::memory_order_acquire);
+    size_t inputs = _input_size.load(std::memory_order_acquire);
+    size_t output = 0;
+    size_t input = 0;
+    uint64_t time = 0;
+    while (output < outputs || input < inputs) {
+        bool take_input = output == outputs || (input < inputs && _inputs[input].time_ns < _transitions[output].time_ns);
+        const Transition& transition = take_input ? _inputs[input++] : _transitions[output++];
+        if (transition.time_ns != time) {
+            time = transition.time_ns;
+            fmt::print(file, "#{}\n", time);
+        }
+        fmt::print(file, "{}{}\n", transition.value, VCD_IDENTIFIERS[index(transition.line)]);
+    }
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written) {
+        logger().error("Failed to write capture file {}", path.native());
+        return false;
+    }
+    return true;
+}
+
+void CaptureBackend::_record(std::vector<Transition>& transitions, std::atomic<size_t>& size, Line line, uint8_t level) const
+{
+    size_t recorded = size.load(std::memory_order_relaxed);
+    if (recorded == transitions.size()) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    transitions[recorded] = {monotonicNow() - _start_ns, line, level};
+    size.store(recorded + 1, std::memory_order_release);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "fanshim/backend.hpp"
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+struct Transition
+{
+    uint64_t time_ns;
+    Line line;
+    uint8_t value;
+};
+
+/**
+ * The LED clock as captured: the period between rising edges within a frame, and the frames themselves. A pause of more than a millisecond between rising
+ * edges separates two frames.
+ */
+struct CaptureTiming
+{
+    uint64_t clock_edges;
+    uint64_t frames;
+    uint64_t min_period_ns;
+    uint64_t mean_period_ns;
+    uint64_t max_period_ns;
+    uint64_t jitter_ns;
+    uint64_t mean_frame_ns;
+};
+
+/**
+ * Records every transition written to the lines of another backend, and every change read from its button line, timestamped with the monotonic clock, into
+ * buffers allocated up front. Once a buffer is full, further transitions are counted but not recorded.
+ *
+ * Writes may be recorded on the realtime worker while the button is read on the event loop, so the two are kept in separate buffers with a single writer each
+ * and merged by time when the capture is written. Only transitions already published are read.
+ */
+class CaptureBackend : public GPIOBackend
+{
+public:
+    CaptureBackend(std::unique_ptr<GPIOBackend> backend, size_t capacity);
+
+    uint8_t read(Line line) const override;
+    void write(Line line, uint8_t value) override;
+    void stretchClock() override;
+
+    /**
+     * Bit-bangs through write(), so that every bit is recorded with the time it reached the inner backend.
+     */
+    void shiftOut(const uint8_t* data, size_t bits) override;
+
+    /**
+     * The transitions recorded, written and read.
+     */
+    size_t size() const;
+    uint64_t dropped() const;
+    CaptureTiming timing() const;
+
+    /**
+     * Writes the capture as a Value Change Dump, with nanosecond timestamps from the start of the capture, under a scope named `name`.
+     */
+    bool writeVCD(const std::filesystem::path& path, std::string_view name) const;
+
+private:
+    CaptureBackend(const CaptureBackend&) = delete;
+    CaptureBackend(CaptureBackend&&) = delete;
+    CaptureBackend& operator=(const CaptureBackend&) = delete;
+    CaptureBackend& operator=(CaptureBackend&&) = delete;
+
+    void _record(std::vector<Transition>& transitions, std::atomic<size_t>& size, Line line, uint8_t level) const;
+
+    std::unique_ptr<GPIOBackend> _backend;
+    std::vector<Transition> _transitions;
+    std::atomic<size_t> _size;
+    mutable std::vector<Transition> _inputs;
+    mutable std::atomic<size_t> _input_size;
+    mutable std::atomic<uint64_t> _dropped;
+    std::array<uint8_t, LINE_COUNT> _levels;
+    mutable uint8_t _button_level;
+    uint64_t _start_ns;
+};
@@ -0,0 +1,463 @@
+#include "fanshim/channel.hpp"
+
+#include "fanshim/color.hpp"
+#include "fanshim/gpio.hpp"
+#include "fanshim/logger.hpp"
+#include "fanshim/periodic_task.hpp"
+#include "fanshim/sensor.hpp"
+#include "fanshim/throttle.hpp"
+
+#include <uv.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+
+inline constexpr double S = 1.0;
+inline constexpr uint8_t BLINK_TICKS = 5;
+
+
+Channel::Channel(uv_loop_t* loop,
+                 Clock& clock,
+                 const ChannelConfiguration& configuration,
+                 const Configuration& global,
+                 std::unique_ptr<GPIOBackend> backend,
+                 std::unique_ptr<TemperatureSource> sensor,
+                 RealtimeWorker* realtime)
+    : _config(configuration),
+      _global(global),
+      _clock(clock),
+      _gpio(configuration, std::move(backend), realtime),
+      _sensor(std::move(sensor)),
+      _filter(configuration.filter),
+      _force_handle(),
+      _dwell_handle(),
+      _stats(),
+      _on_fan_change(),
+      _on_closed(),
+      _open_timers(0),
+      _tick_count(0),
+      _v((global.brightness() * 1.0) / MAX_BRIGHTNESS),
+      _temperature(NO_TEMPERATURE),
+      _raw_temperature(NO_TEMPERATURE),
+      _load_bias(0.0),
+      _trip_point(readTripPoint(configuration.sensor)),
+      _last_transition(0),
+      _band(0),
+      _force(ForceState::NONE),
+      _button(false),
+      _temp_disabling_button(false),
+      _override_disabling_button(false),
+      _throttle_hold(false)
+{
+    // Configurations built in code may only set the thresholds, which are the single-band case.
+    if (_config.bands.empty()) {
+        _config.bands.push_back({_config.on_threshold, _config.off_threshold, MAX_DUTY});
+    }
+
+    uv_timer_init(loop, &_force_handle);
+    _force_handle.data = this;
+    uv_timer_init(loop, &_dwell_handle);
+    _dwell_handle.data = this;
+    _open_timers = 2;
+}
+
+Channel::~Channel()
+{
+    _clock.stop(&_force_handle);
+    _clock.stop(&_dwell_handle);
+}
+
+const std::string& Channel::name() const
+{
+    return _config.name;
+}
+
+const ChannelConfiguration& Channel::configuration() const
+{
+    return _config;
+}
+
+double Channel::temperature() const
+{
+    return _temperature;
+}
+
+double Channel::rawTemperature() const
+{
+    return _raw_temperature;
+}
+
+bool Channel::fan() const
+{
+    return _gpio.getFan();
+}
+
+uint8_t Channel::duty() const
+{
+    return _gpio.getFanDuty();
+}
+
+size_t Channel::band() const
+{
+    return _band;
+}
+
+bool Channel::button() const
+{
+    return _button;
+}
+
+bool Channel::overrideActive() const
+{
+    return _override_disabling_button;
+}
+
+bool Channel::temperatureActive() const
+{
+    return _temp_disabling_button;
+}
+
+ForceState Channel::forceState() const
+{
+    return _force;
+}
+
+double Channel::loadBias() const
+{
+    return _load_bias;
+}
+
+double Channel::tripPoint() const
+{
+    return _trip_point;
+}
+
+bool Channel::nearTripPoint() const
+{
+    return _trip_point > 0.0 && _temperature >= _trip_point - _global.tripMargin();
+}
+
+bool Channel::throttleHold() const
+{
+    return _throttle_hold;
+}
+
+std::chrono::milliseconds Channel::forceRemaining() const
+{
+    if (_force == ForceState::NONE) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(_clock.dueIn(&_force_handle));
+}
+
+const ChannelStats& Channel::stats() const
+{
+    return _stats;
+}
+
+const ShadowStats& Channel::gpioStats() const
+{
+    return _gpio.shadowStats();
+}
+
+const FilterStats& Channel::filterStats() const
+{
+    return _filter.stats();
+}
+
+uint32_t Channel::blinkLED(uint32_t ticks)
+{
+    // The LED only blinks while the fan is off, and holds its phase while the fan runs.
+    if (_gpio.getFan()) {
+        return 0;
+    }
+
+    _tick_count += ticks;
+    if (_tick_count % BLINK_TICKS == 0) {
+        _gpio.setBrightness(_tick_count % (2 * BLINK_TICKS) == 0 ? OFF : _global.brightness());
+    }
+    return BLINK_TICKS - _tick_count % BLINK_TICKS;
+}
+
+uint32_t Channel::breatheLED(const std::vector<uint8_t>& breath_values, uint32_t ticks)
+{
+    if (breath_values.empty()) {
+        return 0;
+    }
+
+    // _tick_count is the index of the next value to show, so the value for the last of the elapsed ticks is one before it.
+    _tick_count += ticks - 1;
+    size_t current = _tick_count % breath_values.size();
+    _gpio.setBrightness(breath_values[current]);
+    _tick_count++;
+
+    for (uint32_t next = 1; next < breath_values.size(); ++next) {
+        if (breath_values[(current + next) % breath_values.size()] != breath_values[current]) {
+            return next;
+        }
+    }
+    return 0;
+}
+
+void Channel::checkButton()
+{
+    if (!_gpio.hasButton()) {
+        return;
+    }
+
+    if (_override_disabling_button || _temp_disabling_button) {
+        logger().debug("Channel {} is skipping the button check due to state [Override: {}, Temperature: {}]", _config.name, _override_disabling_button, _temp_disabling_button);
+        return;
+    }
+
+    _button = _gpio.getButton();
+    if (_button) {
+        _setFan(MAX_DUTY);
+    }
+    else if (_gpio.getFan()) {
+        _setFan(0);
+    }
+}
+
+void Channel::checkOverride(bool override_requested)
+{
+    if (_gpio.getFan()) {
+        logger().debug("Channel {} fan already running, skipping override", _config.name);
+        return;
+    }
+
+    if (!override_requested) {
+        _override_disabling_button = false;
+        return;
+    }
+
+    logger().warn("Override file exists, enabling fan {}", _config.name);
+    _override_disabling_button = true;
+    _setFan(MAX_DUTY);
+}
+
+bool Channel::hasSensor() const
+{
+    return _sensor != nullptr;
+}
+
+void Channel::readTemperature()
+{
+    if (_sensor) {
+        feedTemperature(_sensor->read());
+    }
+}
+
+void Channel::feedTemperature(double temperature)
+{
+    _raw_temperature = temperature;
+    _stats.temperature_reads++;
+
+    double current_temperature = _filter.apply(_raw_temperature);
+    if (std::isnan(current_temperature)) {
+        // Nothing has been read successfully yet; leave the fan to its other inputs rather than act on a made-up temperature.
+        return;
+    }
+
+    _temperature = current_temperature;
+    _applyTemperature(current_temperature);
+
+    RGB ledColor = hsvToRGB(temperatureToHue(current_temperature, _config.on_threshold, _config.off_threshold), S, _v);
+    _gpio.setLED(ledColor);
+
+    logger().info("Channel {} Temperature: {} (Raw: {}), Fan State: {}, LED Color: [0x{:02X}{:02X}{:02X}]",
+                  _config.name,
+                  current_temperature,
+                  _raw_temperature,
+                  _gpio.getFan(),
+                  ledColor.red,
+                  ledColor.blue,
+                  ledColor.green);
+}
+
+void Channel::reconcileLines()
+{
+    if (_gpio.reconcile() > 0) {
+        logger().warn("Channel {} output lines were changed externally, fan is now {}", _config.name, _gpio.getFan() ? "on" : "off");
+    }
+}
+
+void Channel::setBrightness(uint8_t brightness)
+{
+    _gpio.setBrightness(brightness);
+}
+
+void Channel::shutdown()
+{
+    // Set GPIO to default state
+    _clock.stop(&_force_handle);
+    _clock.stop(&_dwell_handle);
+    _gpio.setFan(false);
+    _gpio.setBrightness(OFF);
+}
+
+void Channel::setLoadBias(double bias)
+{
+    if (bias == _load_bias) {
+        return;
+    }
+
+    logger().warn("Channel {} thresholds biased by {} degrees for load", _config.name, bias);
+    _load_bias = bias;
+    _applyTemperature(_temperature);
+}
+
+void Channel::setThrottleHold(bool hold)
+{
+    if (hold == _throttle_hold) {
+        return;
+    }
+
+    logger().warn("Fan {} {} for throttling", _config.name, hold ? "held on" : "released");
+    _throttle_hold = hold;
+    if (hold) {
+        _setFan(MAX_DUTY);
+    }
+    else {
+        _applyTemperature(_temperature);
+    }
+}
+
+void Channel::onFanChange(FanCallback callback)
+{
+    _on_fan_change = std::move(callback);
+}
+
+void Channel::force(bool on, std::chrono::milliseconds ttl)
+{
+    int32_t result = _clock.start(&_force_handle, dispatchTimer<Channel, &Channel::_onForceExpired>, ttl.count(), 0);
+    if (result) {
+        logger().error("Failed to start force expiry timer for {}: {}", _config.name, uv_strerror(result));
+        return;
+    }
+
+    logger().warn("Fan {} forced {} for {} ms", _config.name, on ? "on" : "off", ttl.count());
+    _force = on ? ForceState::ON : ForceState::OFF;
+    _setFan(on ? MAX_DUTY : 0);
+}
+
+void Channel::clearForce()
+{
+    _clock.stop(&_force_handle);
+    if (_force == ForceState::NONE) {
+        return;
+    }
+
+    logger().warn("Fan {} force cleared", _config.name);
+    _force = ForceState::NONE;
+    _applyTemperature(_temperature);
+}
+
+void Channel::close(CloseCallback callback)
+{
+    _clock.stop(&_force_handle);
+    _clock.stop(&_dwell_handle);
+    _on_closed = std::move(callback);
+    uv_close(reinterpret_cast<uv_handle_t*>(&_force_handle), _onTimerClosed);
+    uv_close(reinterpret_cast<uv_handle_t*>(&_dwell_handle), _onTimerClosed);
+}
+
+void Channel::_onTimerClosed(uv_handle_t* handle)
+{
+    Channel* self = static_cast<Channel*>(handle->data);
+    if (--self->_open_timers == 0 && self->_on_closed) {
+        self->_on_closed();
+    }
+}
+
+void Channel::_applyTemperature(double temperature)
+{
+    // Until a sample has been read successfully there is no temperature to act on, so a force expiring or a load or throttle change leaves the fan alone.
+    if (std::isnan(temperature)) {
+        return;
+    }
+
+    // Each band has its own hysteresis: it engages at its on-threshold and only releases below its off-threshold, so a noisy sample between the two never
+    // moves the fan.
+    const std::vector<FanBand>& bands = _config.bands;
+    size_t band = _band;
+    while (band < bands.size() && temperature >= bands[band].on_threshold - _load_bias) {
+        band++;
+    }
+    while (band > 0 && temperature < bands[band - 1].off_threshold - _load_bias) {
+        band--;
+    }
+
+    if (band != _band) {
+        logger().info("Channel {} moved from band {} to band {} at {}", _config.name, _band, band, temperature);
+        _band = band;
+    }
+
+    if (band > 0) {
+        _temp_disabling_button = true;
+        _setFan(bands[band - 1].duty);
+    }
+    else if (temperature < bands.front().off_threshold - _load_bias) {
+        _temp_disabling_button = false;
+        _setFan(0);
+    }
+}
+
+void Channel::_setFan(uint8_t duty)
+{
+    // A forced state from the control socket takes precedence over every other input until it expires or is cleared.
+    bool exempt = true;
+    if (_force != ForceState::NONE) {
+        duty = _force == ForceState::ON ? MAX_DUTY : 0;
+    }
+    else if (_throttle_hold) {
+        duty = MAX_DUTY;
+    }
+    else {
+        exempt = false;
+    }
+
+    bool on = _gpio.getFan();
+    bool changed = on != (duty > 0);
+
+    // Any other input has to wait until the fan has been in its current state for the minimum dwell time; the dwell timer re-applies the temperature then.
+    if (changed && !exempt && _stats.fan_transitions > 0) {
+        uint64_t dwell = static_cast<uint64_t>((on ? _global.minOnTime() : _global.minOffTime()).count());
+        uint64_t elapsed = _clock.now() - _last_transition;
+        if (elapsed < dwell) {
+            if (_clock.dueIn(&_dwell_handle) == 0) {
+                _stats.dwell_holds++;
+                _clock.start(&_dwell_handle, dispatchTimer<Channel, &Channel::_onDwellExpired>, dwell - elapsed, 0);
+            }
+            logger().debug("Channel {} fan held {} for another {} ms", _config.name, on ? "on" : "off", dwell - elapsed);
+            return;
+        }
+    }
+
+    _gpio.setFanDuty(duty);
+
+    if (changed) {
+        _stats.fan_transitions++;
+        _last_transition = _clock.now();
+        _clock.stop(&_dwell_handle);
+        if (_on_fan_change) {
+            _on_fan_change();
+        }
+    }
+}
+
+void Channel::_onDwellExpired()
+{
+    _applyTemperature(_temperature);
+}
+
+void Channel::_onForceExpired()
+{
+    logger().warn("Fan {} force expired", _config.name);
+    _force = ForceState::NONE;
+    _applyTemperature(_temperature);
+}
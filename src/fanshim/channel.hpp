@@ -0,0 +1,163 @@
+#pragma once
+
+#include "fanshim/backend.hpp"
+#include "fanshim/clock.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/filter.hpp"
+#include "fanshim/gpio.hpp"
+#include "fanshim/realtime.hpp"
+#include "fanshim/sensor.hpp"
+
+#include <uv.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+enum class ForceState : uint8_t
+{
+    NONE = 0,
+    ON = 1,
+    OFF = 2
+};
+
+struct ChannelStats
+{
+    uint64_t temperature_reads;
+    uint64_t fan_transitions;
+    uint64_t dwell_holds;
+};
+
+/**
+ * A single fan, along with its optional button and LED, controlled by its own temperature sensor and thresholds.
+ */
+class Channel
+{
+public:
+    using FanCallback = std::function<void()>;
+    using CloseCallback = std::function<void()>;
+
+    Channel(uv_loop_t* loop,
+            Clock& clock,
+            const ChannelConfiguration& configuration,
+            const Configuration& global,
+            std::unique_ptr<GPIOBackend> backend,
+            std::unique_ptr<TemperatureSource> sensor,
+            RealtimeWorker* realtime = nullptr);
+    ~Channel();
+
+    const std::string& name() const;
+    const ChannelConfiguration& configuration() const;
+
+    /**
+     * The filtered temperature the channel acts on (NO_TEMPERATURE until a sample has been read successfully), and the last raw sample (NO_TEMPERATURE if
+     * the read failed).
+     */
+    double temperature() const;
+    double rawTemperature() const;
+    bool fan() const;
+    uint8_t duty() const;
+
+    /**
+     * The number of bands the temperature has engaged; the fan runs at the duty of the highest of them, or is left to other inputs at 0.
+     */
+    size_t band() const;
+    bool button() const;
+    bool overrideActive() const;
+    bool temperatureActive() const;
+    ForceState forceState() const;
+    double loadBias() const;
+    double tripPoint() const;
+    bool nearTripPoint() const;
+    bool throttleHold() const;
+    std::chrono::milliseconds forceRemaining() const;
+    const ChannelStats& stats() const;
+    const ShadowStats& gpioStats() const;
+    const FilterStats& filterStats() const;
+
+    /**
+     * Advance the LED animation by `ticks` LED periods and return the number of periods until its output next changes, or 0 while it is static.
+     */
+    uint32_t blinkLED(uint32_t ticks);
+    uint32_t breatheLED(const std::vector<uint8_t>& breath_values, uint32_t ticks);
+    void checkButton();
+    void checkOverride(bool override_requested);
+    void readTemperature();
+
+    /**
+     * Filters and acts on a temperature read outside the channel, exactly as if its sensor had returned it. Channels created without a sensor are only
+     * updated this way.
+     */
+    void feedTemperature(double temperature);
+    bool hasSensor() const;
+    void reconcileLines();
+    void setBrightness(uint8_t brightness);
+    void shutdown();
+
+    /**
+     * Lowers both thresholds by `bias` degrees, so that anticipated heat turns the fan on early, and re-applies the last temperature read.
+     */
+    void setLoadBias(double bias);
+
+    /**
+     * Holds the fan on, below any forcing from the control socket, while the SoC is throttled.
+     */
+    void setThrottleHold(bool hold);
+
+    /**
+     * Calls `callback` whenever the fan is switched on or off, from whichever input caused it.
+     */
+    void onFanChange(FanCallback callback);
+
+    void force(bool on, std::chrono::milliseconds ttl);
+    void clearForce();
+
+    /**
+     * Stops and closes the channel's timers, calling `callback` once the loop has closed both. The channel must not be destroyed before then.
+     */
+    void close(CloseCallback callback);
+
+private:
+    Channel(const Channel&) = delete;
+    Channel(Channel&&) = delete;
+    Channel& operator=(const Channel&) = delete;
+    Channel& operator=(Channel&&) = delete;
+
+    void _applyTemperature(double temperature);
+    void _setFan(uint8_t duty);
+
+    void _onDwellExpired();
+    void _onForceExpired();
+
+    static void _onTimerClosed(uv_handle_t* handle);
+
+    ChannelConfiguration _config;
+    const Configuration& _global;
+    Clock& _clock;
+    GPIOInterface _gpio;
+    std::unique_ptr<TemperatureSource> _sensor;
+    TemperatureFilter _filter;
+    uv_timer_t _force_handle;
+    uv_timer_t _dwell_handle;
+    ChannelStats _stats;
+    FanCallback _on_fan_change;
+    CloseCallback _on_closed;
+    uint32_t _open_timers;
+    uint8_t _tick_count;
+    double _v;
+    double _temperature;
+    double _raw_temperature;
+    double _load_bias;
+    double _trip_point;
+    uint64_t _last_transition;
+    size_t _band;
+    ForceState _force;
+    bool _button;
+    bool _temp_disabling_button;
+    bool _override_disabling_button;
+    bool _throttle_hold;
+};
@@ -0,0 +1,156 @@
+#include "fanshim/clock.hpp"
+
+#include <uv.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+
+inline constexpr uint64_t NANOSECONDS_PER_MILLISECOND = 1000000;
+inline constexpr uint64_t NEVER = std::numeric_limits<uint64_t>::max();
+
+
+LoopClock::LoopClock(uv_loop_t* loop) : _loop(loop)
+{}
+
+uint64_t LoopClock::now() const
+{
+    return uv_now(_loop);
+}
+
+uint64_t LoopClock::hrtime() const
+{
+    return uv_hrtime();
+}
+
+int32_t LoopClock::start(uv_timer_t* handle, uv_timer_cb callback, uint64_t timeout, uint64_t repeat)
+{
+    return uv_timer_start(handle, callback, timeout, repeat);
+}
+
+void LoopClock::stop(uv_timer_t* handle)
+{
+    uv_timer_stop(handle);
+}
+
+uint64_t LoopClock::dueIn(const uv_timer_t* handle) const
+{
+    return uv_timer_get_due_in(handle);
+}
+
+VirtualClock::VirtualClock() : _timers(), _now(0), _order(0), _wakeups(0), _callbacks(0), _last_wakeup(NEVER)
+{}
+
+uint64_t VirtualClock::now() const
+{
+    return _now;
+}
+
+uint64_t VirtualClock::hrtime() const
+{
+    return _now * NANOSECONDS_PER_MILLISECOND;
+}
+
+int32_t VirtualClock::start(uv_timer_t* handle, uv_timer_cb callback, uint64_t timeout, uint64_t repeat)
+{
+    if (!callback) {
+        return UV_EINVAL;
+    }
+
+    stop(handle);
+    _timers.push_back({handle, callback, _now + timeout, repeat, _order++});
+    return 0;
+}
+
+void VirtualClock::stop(uv_timer_t* handle)
+{
+    auto timer = _find(handle);
+    if (timer != _timers.end()) {
+        _timers.erase(timer);
+    }
+}
+
+uint64_t VirtualClock::dueIn(const uv_timer_t* handle) const
+{
+    auto timer = _find(handle);
+    if (timer == _timers.end()) {
+        return 0;
+    }
+    return timer->due > _now ? timer->due - _now : 0;
+}
+
+uint64_t VirtualClock::nextDue() const
+{
+    uint64_t due = NEVER;
+    for (const auto& timer : _timers) {
+        due = std::min(due, timer.due);
+    }
+    return due;
+}
+
+bool VirtualClock::runNext()
+{
+    auto timer = _next();
+    if (timer == _timers.end()) {
+        return false;
+    }
+
+    _now = std::max(_now, timer->due);
+    if (_last_wakeup != _now) {
+        _last_wakeup = _now;
+        _wakeups++;
+    }
+
+    uv_timer_t* handle = timer->handle;
+    uv_timer_cb callback = timer->callback;
+
+    // Like libuv, a repeating timer is re-armed before its callback runs, so the callback is free to stop or restart it.
+    if (timer->repeat) {
+        timer->due = _now + timer->repeat;
+        timer->order = _order++;
+    }
+    else {
+        _timers.erase(timer);
+    }
+
+    _callbacks++;
+    callback(handle);
+    return true;
+}
+
+void VirtualClock::runUntil(uint64_t time)
+{
+    while (nextDue() <= time) {
+        runNext();
+    }
+    _now = std::max(_now, time);
+}
+
+uint64_t VirtualClock::wakeups() const
+{
+    return _wakeups;
+}
+
+uint64_t VirtualClock::callbacks() const
+{
+    return _callbacks;
+}
+
+std::vector<VirtualClock::Timer>::iterator VirtualClock::_find(const uv_timer_t* handle)
+{
+    return std::find_if(_timers.begin(), _timers.end(), [handle](const Timer& timer) { return timer.handle == handle; });
+}
+
+std::vector<VirtualClock::Timer>::const_iterator VirtualClock::_find(const uv_timer_t* handle) const
+{
+    return std::find_if(_timers.begin(), _timers.end(), [handle](const Timer& timer) { return timer.handle == handle; });
+}
+
+std::vector<VirtualClock::Timer>::iterator VirtualClock::_next()
+{
+    return std::min_element(_timers.begin(), _timers.end(), [](const Timer& left, const Timer& right) {
+        return left.due < right.due || (left.due == right.due && left.order < right.order);
+    });
+}
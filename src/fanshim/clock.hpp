@@ -0,0 +1,113 @@
+#pragma once
+
+#include <uv.h>
+
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * The time source that the driver arms its timers against.
+ *
+ * Timer handles are always initialised on the driver's event loop, so a clock only decides when their callbacks run.
+ */
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    /**
+     * The current time in milliseconds, on the same scale as timer timeouts.
+     */
+    virtual uint64_t now() const = 0;
+
+    /**
+     * The current time in nanoseconds, for timestamps.
+     */
+    virtual uint64_t hrtime() const = 0;
+
+    virtual int32_t start(uv_timer_t* handle, uv_timer_cb callback, uint64_t timeout, uint64_t repeat) = 0;
+    virtual void stop(uv_timer_t* handle) = 0;
+    virtual uint64_t dueIn(const uv_timer_t* handle) const = 0;
+};
+
+/**
+ * Runs timers on a libuv event loop in real time.
+ */
+class LoopClock : public Clock
+{
+public:
+    LoopClock(uv_loop_t* loop);
+
+    uint64_t now() const override;
+    uint64_t hrtime() const override;
+
+    int32_t start(uv_timer_t* handle, uv_timer_cb callback, uint64_t timeout, uint64_t repeat) override;
+    void stop(uv_timer_t* handle) override;
+    uint64_t dueIn(const uv_timer_t* handle) const override;
+
+private:
+    LoopClock(const LoopClock&) = delete;
+    LoopClock(LoopClock&&) = delete;
+    LoopClock& operator=(const LoopClock&) = delete;
+    LoopClock& operator=(LoopClock&&) = delete;
+
+    uv_loop_t* _loop;
+};
+
+/**
+ * Runs timers in virtual time, which only advances when asked to, so hours of driver behaviour can be replayed in seconds.
+ *
+ * Timers due at the same instant fire in the order they were started, as they would on a libuv loop, and count as a single wakeup.
+ */
+class VirtualClock : public Clock
+{
+public:
+    VirtualClock();
+
+    uint64_t now() const override;
+    uint64_t hrtime() const override;
+
+    int32_t start(uv_timer_t* handle, uv_timer_cb callback, uint64_t timeout, uint64_t repeat) override;
+    void stop(uv_timer_t* handle) override;
+    uint64_t dueIn(const uv_timer_t* handle) const override;
+
+    /**
+     * The time at which the next timer is due, or UINT64_MAX if no timer is active.
+     */
+    uint64_t nextDue() const;
+
+    /**
+     * Advances to the next due timer and runs its callback. Returns false if no timer is active.
+     */
+    bool runNext();
+
+    /**
+     * Runs every timer due up to and including `time`, then advances to `time`.
+     */
+    void runUntil(uint64_t time);
+
+    uint64_t wakeups() const;
+    uint64_t callbacks() const;
+
+private:
+    struct Timer
+    {
+        uv_timer_t* handle;
+        uv_timer_cb callback;
+        uint64_t due;
+        uint64_t repeat;
+        uint64_t order;
+    };
+
+    std::vector<Timer>::iterator _find(const uv_timer_t* handle);
+    std::vector<Timer>::const_iterator _find(const uv_timer_t* handle) const;
+    std::vector<Timer>::iterator _next();
+
+    std::vector<Timer> _timers;
+    uint64_t _now;
+    uint64_t _order;
+    uint64_t _wakeups;
+    uint64_t _callbacks;
+    uint64_t _last_wakeup;
+};
@@ -0,0 +1,40 @@
+#include "fanshim/color.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+static double hsvk(int32_t n, double hue)
+{
+    return std::fmod(n + hue / 60.0, 6);
+}
+
+static double hsvf(int n, double hue, double s, double v)
+{
+    double k = hsvk(n, hue);
+    return v - v * s * std::max({std::min({k, 4 - k, 1.0}), 0.0});
+}
+
+RGB hsvToRGB(double h, double s, double v)
+{
+    double hue = h * 360;
+    RGB rgb;
+    rgb.red = static_cast<uint8_t>(hsvf(5, hue, s, v) * 255);
+    rgb.green = static_cast<uint8_t>(hsvf(3, hue, s, v) * 255);
+    rgb.blue = static_cast<uint8_t>(hsvf(1, hue, s, v) * 255);
+    return rgb;
+}
+
+double temperatureToHue(double temperature, double on_threshold, double off_threshold)
+{
+    // Hue is expected to be the distance the temperature is from the onThreshold represented as a percentage normalized by 1/3.
+    static constexpr double NORMALIZATION_FACTOR = 0.333333;
+    if (temperature < off_threshold) {
+        return NORMALIZATION_FACTOR;
+    }
+    else if (temperature > on_threshold) {
+        return 0.0;
+    }
+    return ((on_threshold - temperature) / (on_threshold - off_threshold)) * NORMALIZATION_FACTOR;
+}
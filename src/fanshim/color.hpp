@@ -0,0 +1,11 @@
+#pragma once
+
+#include "fanshim/gpio.hpp"
+
+
+RGB hsvToRGB(double h, double s, double v);
+
+/**
+ * Maps a temperature onto a hue between green (at or below the off threshold) and red (at or above the on threshold).
+ */
+double temperatureToHue(double temperature, double on_threshold, double off_threshold);
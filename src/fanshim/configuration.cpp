@@ -5,12 +5,22 @@
 
 #include <nlohmann/json.hpp>
 
+#include <spdlog/fmt/fmt.h>
+
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 using json = nlohmann::json;
 
@@ -22,73 +32,691 @@ inline constexpr std::string_view BLINK = "blink";
 inline constexpr std::string_view BREATH_BRIGHTNESS = "breath-brightness";
 inline constexpr std::string_view OUTPUT_FILE = "output-file";
 inline constexpr std::string_view FORCE_FILE = "force-file";
+inline constexpr std::string_view CONTROL_SOCKET = "control-socket";
+inline constexpr std::string_view STATUS_SEGMENT = "status-segment";
+inline constexpr std::string_view CHANNELS = "channels";
+inline constexpr std::string_view LOAD_THRESHOLD = "load-threshold";
+inline constexpr std::string_view LOAD_DURATION = "load-duration";
+inline constexpr std::string_view LOAD_BIAS = "load-bias";
+inline constexpr std::string_view PROC_ROOT = "proc-root";
+inline constexpr std::string_view SYS_ROOT = "sys-root";
+inline constexpr std::string_view TRIP_MARGIN = "trip-margin";
+inline constexpr std::string_view THROTTLE_FAN = "throttle-fan";
+inline constexpr std::string_view RT_PRIORITY = "rt-priority";
+inline constexpr std::string_view RT_CPU = "rt-cpu";
+inline constexpr std::string_view RT_LOCK_MEMORY = "rt-lock-memory";
+inline constexpr std::string_view PWM_FREQUENCY = "pwm-frequency";
+inline constexpr std::string_view RECONCILE_INTERVAL = "reconcile-interval";
+inline constexpr std::string_view MIN_ON_TIME = "min-on-time";
+inline constexpr std::string_view MIN_OFF_TIME = "min-off-time";
+inline constexpr std::string_view BANDS = "bands";
+inline constexpr std::string_view DUTY = "duty";
+inline constexpr std::string_view FILTER = "filter";
+inline constexpr std::string_view MEDIAN_WINDOW = "median-window";
+inline constexpr std::string_view SMOOTHING = "smoothing";
+inline constexpr std::string_view MAX_STEP = "max-step";
+inline constexpr std::string_view MAX_REJECTIONS = "max-rejections";
+inline constexpr std::string_view CAPTURE_DIR = "capture-dir";
+inline constexpr std::string_view CAPTURE_SIZE = "capture-size";
+inline constexpr std::string_view IO_URING = "io-uring";
+inline constexpr std::string_view NAME = "name";
+inline constexpr std::string_view CHIP = "chip";
+inline constexpr std::string_view FAN_PIN = "fan-pin";
+inline constexpr std::string_view BUTTON_PIN = "button-pin";
+inline constexpr std::string_view CLOCK_PIN = "clock-pin";
+inline constexpr std::string_view DATA_PIN = "data-pin";
+inline constexpr std::string_view LED_COUNT = "led-count";
+inline constexpr std::string_view SENSOR = "sensor";
+inline constexpr double UNBOUNDED = std::numeric_limits<double>::infinity();
+
+
+enum class FieldScope : uint8_t
+{
+    ROOT,
+    CHANNEL,
+    BAND,
+    FILTER,
+    IGNORED
+};
+
+enum class FieldKind : uint8_t
+{
+    NONE,
+    BOOLEAN,
+    UNSIGNED,
+    INTEGER,
+    NUMBER,
+    STRING,
+    ARRAY,
+    OBJECT
+};
+
+struct FieldValue
+{
+    FieldKind kind;
+    bool boolean;
+    double number;
+    std::string_view string;
+};
+
+class ConfigurationParser;
+
+/**
+ * A configuration item: where it may appear, what it must be, and how it is stored. Arrays and objects contain items of the `contains` scope, and
+ * their `minimum` and `maximum` bound the number of elements.
+ */
+struct FieldSchema
+{
+    FieldScope scope;
+    std::string_view key;
+    FieldKind kind;
+    double minimum;
+    double maximum;
+    bool (*apply)(ConfigurationParser& parser, const FieldValue& value);
+    FieldScope contains;
+    std::string_view requirement;
+};
+
+static bool isNumber(FieldKind kind)
+{
+    return kind == FieldKind::UNSIGNED || kind == FieldKind::INTEGER || kind == FieldKind::NUMBER;
+}
 
+static bool accepts(const FieldSchema& field, const FieldValue& value)
+{
+    switch (field.kind) {
+    case FieldKind::BOOLEAN:
+    case FieldKind::STRING:
+        return value.kind == field.kind;
+    case FieldKind::UNSIGNED:
+        return value.kind == FieldKind::UNSIGNED && value.number >= field.minimum && value.number <= field.maximum;
+    case FieldKind::INTEGER:
+        return (value.kind == FieldKind::UNSIGNED || value.kind == FieldKind::INTEGER) && value.number >= field.minimum && value.number <= field.maximum;
+    case FieldKind::NUMBER:
+        return isNumber(value.kind) && value.number >= field.minimum && value.number <= field.maximum;
+    case FieldKind::NONE:
+    case FieldKind::ARRAY:
+    case FieldKind::OBJECT:
+    default:
+        return false;
+    }
+}
 
-static bool isValid(const json& configuration)
+static std::string requirement(const FieldSchema& field)
 {
-    // Rules for a "valid" configuration:
-    //      1. It must not be empty
-    //      2. If it contains On Threshold, it must contain Off Threshold too.
-    //          a. On Threshold and Off Threshold must be unsigned integers.
-    //          b. On Threshold must be greater than Off Threshold.
-    //      3. If it contains Delay, Delay must be an unsigned integer.
-    //      4. If it contains Brightness, Brightness must be an unsigned integer.
-    //      5. If it contains Blink, Blink must be an unsigned integer.
-    //          a. Blink must be a valid BlinkType.
-    //      6. If it contains Breath Brightness, Breath Brightness must be an unsigned integer.
-    //          a. Breath Brightness must be less than MAX_BRIGHTNESS
-    //      7. If it contains Output File, Output File must be a string.
-    //      8. If it contains Force File, Force File must be a string.
+    if (!field.requirement.empty()) {
+        return std::string(field.requirement);
+    }
 
-    if (configuration.empty()) {
-        return false;
+    std::string range;
+    if (field.maximum != UNBOUNDED) {
+        range = fmt::format(" from {} to {}", field.minimum, field.maximum);
     }
+    else if (field.minimum > 0) {
+        range = fmt::format(" of at least {}", field.minimum);
+    }
+    switch (field.kind) {
+    case FieldKind::BOOLEAN:
+        return "a boolean";
+    case FieldKind::STRING:
+        return "a string";
+    case FieldKind::UNSIGNED:
+        return "an unsigned integer" + range;
+    case FieldKind::INTEGER:
+        return "an integer" + range;
+    case FieldKind::NUMBER:
+        return "a number" + range;
+    case FieldKind::ARRAY:
+        return fmt::format("an array of {} to {} objects", field.minimum, field.maximum);
+    case FieldKind::OBJECT:
+    case FieldKind::NONE:
+    default:
+        return "an object";
+    }
+}
 
-    if ((configuration.contains(ON_THRESHOLD) && !configuration.contains(OFF_THRESHOLD)) || (!configuration.contains(ON_THRESHOLD) && configuration.contains(OFF_THRESHOLD))) {
-        return false;
+template <typename T>
+static void assign(T& target, const FieldValue& value)
+{
+    if constexpr (std::is_same_v<T, bool>) {
+        target = value.boolean;
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        target = static_cast<T>(value.number);
+    }
+    else if constexpr (std::is_same_v<T, std::chrono::milliseconds>) {
+        target = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::seconds(static_cast<uint32_t>(value.number)));
     }
+    else {
+        target = T(std::string(value.string));
+    }
+}
+
 
-    if (configuration.contains(ON_THRESHOLD) && configuration.contains(OFF_THRESHOLD)) {
-        if (!configuration[ON_THRESHOLD].is_number() || !configuration[OFF_THRESHOLD].is_number() ||
-            configuration[ON_THRESHOLD].get<uint8_t>() < configuration[OFF_THRESHOLD].get<uint8_t>()) {
+/**
+ * Validates and applies a configuration file in a single pass over the JSON events, without building a document. Every item is looked up once in a schema
+ * table, and every invalid item is reported rather than only the first. Rules that relate several items are checked as each object ends, and channels
+ * inherit the top-level thresholds, bands and filter once the whole file has been read, so items may appear in any order.
+ */
+class ConfigurationParser : public nlohmann::json_sax<json>
+{
+public:
+    ConfigurationParser(Configuration& configuration)
+        : _configuration(configuration), _frames(), _field(nullptr), _key(), _channels(), _names(), _bands(nullptr), _filter(nullptr), _errors(), _parsed(false)
+    {}
+
+    /**
+     * Resolves what the channels inherit. Returns false if the file was not valid, leaving the reasons in errors().
+     */
+    bool finish()
+    {
+        if (!_parsed && _errors.empty()) {
+            _errors.push_back("the configuration is empty");
+        }
+        if (!_errors.empty()) {
             return false;
         }
+
+        Configuration& configuration = _configuration;
+        if (!configuration._bands.empty()) {
+            // The first band replaces the top-level thresholds, so that everything derived from them (such as the LED color) follows the bands.
+            configuration._on_threshold = configuration._bands.front().on_threshold;
+            configuration._off_threshold = configuration._bands.front().off_threshold;
+        }
+
+        for (auto& entry : _channels) {
+            ChannelConfiguration& channel = entry.configuration;
+            if (!entry.has_thresholds) {
+                channel.on_threshold = configuration._on_threshold;
+                channel.off_threshold = configuration._off_threshold;
+            }
+            if (entry.has_bands) {
+                channel.on_threshold = channel.bands.front().on_threshold;
+                channel.off_threshold = channel.bands.front().off_threshold;
+            }
+            else if (!entry.has_thresholds) {
+                channel.bands = configuration._bands;
+            }
+            if (channel.bands.empty()) {
+                channel.bands.push_back({channel.on_threshold, channel.off_threshold, MAX_DUTY});
+            }
+            if (!entry.has_filter) {
+                channel.filter = configuration._filter;
+            }
+            configuration._channels.push_back(channel);
+        }
+        return true;
     }
 
-    if (configuration.contains(DELAY) && !configuration[DELAY].is_number()) {
-        return false;
+    const std::vector<std::string>& errors() const
+    {
+        return _errors;
+    }
+
+    bool null() override
+    {
+        return _value({FieldKind::NONE, false, 0.0, {}});
+    }
+
+    bool boolean(bool value) override
+    {
+        return _value({FieldKind::BOOLEAN, value, 0.0, {}});
+    }
+
+    bool number_integer(number_integer_t value) override
+    {
+        return _value({value < 0 ? FieldKind::INTEGER : FieldKind::UNSIGNED, false, static_cast<double>(value), {}});
+    }
+
+    bool number_unsigned(number_unsigned_t value) override
+    {
+        return _value({FieldKind::UNSIGNED, false, static_cast<double>(value), {}});
+    }
+
+    bool number_float(number_float_t value, const string_t& /* unused */) override
+    {
+        return _value({FieldKind::NUMBER, false, value, {}});
+    }
+
+    bool string(string_t& value) override
+    {
+        return _value({FieldKind::STRING, false, 0.0, value});
+    }
+
+    bool binary(binary_t& /* unused */) override
+    {
+        return _value({FieldKind::NONE, false, 0.0, {}});
+    }
+
+    bool key(string_t& key) override
+    {
+        Frame& frame = _frames.back();
+        frame.keys++;
+        _key = key;
+        _field = _find(frame.scope, key);
+        if (_field) {
+            frame.seen.push_back(_field);
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t /* unused */) override
+    {
+        if (_frames.empty()) {
+            _parsed = true;
+            _frames.push_back({FieldScope::ROOT, false, "", 0, 0, {}, nullptr});
+            return true;
+        }
+
+        FieldScope scope = _container(FieldKind::OBJECT);
+        bool in_channel = _channelScope();
+        _frames.push_back({scope, false, _path(), 0, 0, {}, nullptr});
+        switch (scope) {
+        case FieldScope::CHANNEL:
+            // Explicit channels only drive the lines they name; the Fan SHIM button and LED pins are not assumed.
+            _channels.push_back(
+                {{"", std::string(DEFAULT_CHIP_NAME), NO_PIN, NO_PIN, NO_PIN, NO_PIN, DEFAULT_LED_COUNT, DEFAULT_SENSOR_FILE, 0.0, 0.0, {}, {}}, false, false, false});
+            break;
+        case FieldScope::BAND:
+            _bands->push_back({0.0, 0.0, MAX_DUTY});
+            break;
+        case FieldScope::FILTER:
+            _filter = in_channel ? &_channels.back().configuration.filter : &_configuration._filter;
+            *_filter = {0, 0, 0.0, DEFAULT_MAX_REJECTIONS};
+            break;
+        case FieldScope::ROOT:
+        case FieldScope::IGNORED:
+        default:
+            break;
+        }
+        return true;
+    }
+
+    bool end_object() override
+    {
+        const Frame& frame = _frames.back();
+        switch (frame.scope) {
+        case FieldScope::ROOT:
+            _endRoot(frame);
+            break;
+        case FieldScope::CHANNEL:
+            _endChannel(frame);
+            break;
+        case FieldScope::BAND:
+            _endBand(frame);
+            break;
+        case FieldScope::FILTER:
+        case FieldScope::IGNORED:
+        default:
+            break;
+        }
+        return _pop();
+    }
+
+    bool start_array(std::size_t /* unused */) override
+    {
+        if (_frames.empty()) {
+            _parsed = true;
+            _errors.push_back("the configuration must be an object");
+            _frames.push_back({FieldScope::IGNORED, true, "", 0, 0, {}, nullptr});
+            return true;
+        }
+
+        FieldScope scope = _container(FieldKind::ARRAY);
+        if (scope == FieldScope::CHANNEL) {
+            _channels.clear();
+            _names.clear();
+        }
+        else if (scope == FieldScope::BAND) {
+            _bands = _channelScope() ? &_channels.back().configuration.bands : &_configuration._bands;
+            _bands->clear();
+        }
+        _frames.push_back({scope, true, _path(), 0, 0, {}, scope == FieldScope::IGNORED ? nullptr : _field});
+        return true;
+    }
+
+    bool end_array() override
+    {
+        const Frame& frame = _frames.back();
+        if (frame.field && (frame.index < frame.field->minimum || frame.index > frame.field->maximum)) {
+            _error(frame.path, requirement(*frame.field));
+        }
+        return _pop();
     }
 
-    if (configuration.contains(BRIGHTNESS) && !configuration[BRIGHTNESS].is_number()) {
+    bool parse_error(std::size_t /* unused */, const std::string& /* unused */, const nlohmann::detail::exception& exception) override
+    {
+        _errors.push_back(exception.what());
         return false;
     }
 
-    if (configuration.contains(BLINK)) {
-        if (!configuration[BLINK].is_number() || configuration[BLINK].get<uint8_t>() > static_cast<uint8_t>(BlinkType::BREATHE)) {
-            return false;
+private:
+    ConfigurationParser(const ConfigurationParser&) = delete;
+    ConfigurationParser(ConfigurationParser&&) = delete;
+    ConfigurationParser& operator=(const ConfigurationParser&) = delete;
+    ConfigurationParser& operator=(ConfigurationParser&&) = delete;
+
+    struct Frame
+    {
+        FieldScope scope;
+        bool array;
+        std::string path;
+        size_t index;
+        size_t keys;
+        std::vector<const FieldSchema*> seen;
+        const FieldSchema* field;
+    };
+
+    struct ChannelEntry
+    {
+        ChannelConfiguration configuration;
+        bool has_thresholds;
+        bool has_bands;
+        bool has_filter;
+    };
+
+    template <auto Member>
+    static bool setGlobal(ConfigurationParser& parser, const FieldValue& value)
+    {
+        assign(parser._configuration.*Member, value);
+        return true;
+    }
+
+    template <auto Member>
+    static bool setChannel(ConfigurationParser& parser, const FieldValue& value)
+    {
+        assign(parser._channels.back().configuration.*Member, value);
+        return true;
+    }
+
+    template <auto Member>
+    static bool setBand(ConfigurationParser& parser, const FieldValue& value)
+    {
+        assign(parser._bands->back().*Member, value);
+        return true;
+    }
+
+    template <auto Member>
+    static bool setFilter(ConfigurationParser& parser, const FieldValue& value)
+    {
+        assign(parser._filter->*Member, value);
+        return true;
+    }
+
+    /**
+     * Top-level and channel thresholds are whole degrees.
+     */
+    template <auto Member>
+    static bool setGlobalThreshold(ConfigurationParser& parser, const FieldValue& value)
+    {
+        parser._configuration.*Member = static_cast<uint8_t>(value.number);
+        return true;
+    }
+
+    template <auto Member>
+    static bool setChannelThreshold(ConfigurationParser& parser, const FieldValue& value)
+    {
+        parser._channels.back().configuration.*Member = static_cast<uint8_t>(value.number);
+        return true;
+    }
+
+    static const std::vector<FieldSchema>& fields()
+    {
+        // clang-format off
+        static const std::vector<FieldSchema> FIELDS = {
+            {FieldScope::ROOT, ON_THRESHOLD, FieldKind::NUMBER, 0, UINT8_MAX, setGlobalThreshold<&Configuration::_on_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, OFF_THRESHOLD, FieldKind::NUMBER, 0, UINT8_MAX, setGlobalThreshold<&Configuration::_off_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, DELAY, FieldKind::NUMBER, 0, UINT8_MAX, setGlobal<&Configuration::_delay>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, BRIGHTNESS, FieldKind::NUMBER, 0, MAX_BRIGHTNESS, setGlobal<&Configuration::_brightness>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, BLINK, FieldKind::NUMBER, 0, static_cast<double>(BlinkType::BREATHE),
+             [](ConfigurationParser& parser, const FieldValue& value) {
+                 parser._configuration._blink = static_cast<BlinkType>(value.number);
+                 return true;
+             },
+             FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, BREATH_BRIGHTNESS, FieldKind::NUMBER, 0, MAX_BRIGHTNESS, setGlobal<&Configuration::_breath_brightness>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, OUTPUT_FILE, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_output_file>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, FORCE_FILE, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_force_file>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, CONTROL_SOCKET, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_control_socket>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, STATUS_SEGMENT, FieldKind::STRING, 0, 0,
+             [](ConfigurationParser& parser, const FieldValue& value) {
+                 if (!value.string.empty() && value.string.front() != '/') {
+                     return false;
+                 }
+                 parser._configuration._status_segment = std::string(value.string);
+                 return true;
+             },
+             FieldScope::IGNORED, "an empty string or a name starting with '/'"},
+            {FieldScope::ROOT, CHANNELS, FieldKind::ARRAY, 1, MAX_CHANNELS, nullptr, FieldScope::CHANNEL, {}},
+            {FieldScope::ROOT, LOAD_THRESHOLD, FieldKind::UNSIGNED, 0, MAX_LOAD_THRESHOLD, setGlobal<&Configuration::_load_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, LOAD_DURATION, FieldKind::UNSIGNED, 0, UINT32_MAX, setGlobal<&Configuration::_load_duration>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, LOAD_BIAS, FieldKind::UNSIGNED, 0, UINT8_MAX, setGlobal<&Configuration::_load_bias>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, PROC_ROOT, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_proc_root>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, SYS_ROOT, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_sys_root>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, TRIP_MARGIN, FieldKind::UNSIGNED, 0, UINT8_MAX, setGlobal<&Configuration::_trip_margin>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, THROTTLE_FAN, FieldKind::BOOLEAN, 0, 0, setGlobal<&Configuration::_throttle_fan>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, RT_PRIORITY, FieldKind::UNSIGNED, 0, MAX_RT_PRIORITY, setGlobal<&Configuration::_rt_priority>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, RT_CPU, FieldKind::INTEGER, NO_CPU, INT32_MAX, setGlobal<&Configuration::_rt_cpu>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, RT_LOCK_MEMORY, FieldKind::BOOLEAN, 0, 0, setGlobal<&Configuration::_rt_lock_memory>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, PWM_FREQUENCY, FieldKind::UNSIGNED, 1, MAX_PWM_FREQUENCY, setGlobal<&Configuration::_pwm_frequency>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, RECONCILE_INTERVAL, FieldKind::UNSIGNED, 0, UINT32_MAX, setGlobal<&Configuration::_reconcile_interval>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, MIN_ON_TIME, FieldKind::UNSIGNED, 0, UINT32_MAX, setGlobal<&Configuration::_min_on_time>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, MIN_OFF_TIME, FieldKind::UNSIGNED, 0, UINT32_MAX, setGlobal<&Configuration::_min_off_time>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, BANDS, FieldKind::ARRAY, 1, MAX_BANDS, nullptr, FieldScope::BAND, {}},
+            {FieldScope::ROOT, FILTER, FieldKind::OBJECT, 0, 0, nullptr, FieldScope::FILTER, {}},
+            {FieldScope::ROOT, CAPTURE_DIR, FieldKind::STRING, 0, 0, setGlobal<&Configuration::_capture_directory>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, CAPTURE_SIZE, FieldKind::UNSIGNED, 1, MAX_CAPTURE_SIZE, setGlobal<&Configuration::_capture_size>, FieldScope::IGNORED, {}},
+            {FieldScope::ROOT, IO_URING, FieldKind::BOOLEAN, 0, 0, setGlobal<&Configuration::_io_uring>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, NAME, FieldKind::STRING, 0, 0, setChannel<&ChannelConfiguration::name>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, CHIP, FieldKind::STRING, 0, 0, setChannel<&ChannelConfiguration::chip>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, FAN_PIN, FieldKind::UNSIGNED, 0, INT32_MAX, setChannel<&ChannelConfiguration::fan_pin>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, BUTTON_PIN, FieldKind::UNSIGNED, 0, INT32_MAX, setChannel<&ChannelConfiguration::button_pin>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, CLOCK_PIN, FieldKind::UNSIGNED, 0, INT32_MAX, setChannel<&ChannelConfiguration::clock_pin>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, DATA_PIN, FieldKind::UNSIGNED, 0, INT32_MAX, setChannel<&ChannelConfiguration::data_pin>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, LED_COUNT, FieldKind::UNSIGNED, 1, MAX_LED_COUNT, setChannel<&ChannelConfiguration::led_count>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, SENSOR, FieldKind::STRING, 0, 0, setChannel<&ChannelConfiguration::sensor>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, ON_THRESHOLD, FieldKind::NUMBER, 0, UINT8_MAX, setChannelThreshold<&ChannelConfiguration::on_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, OFF_THRESHOLD, FieldKind::NUMBER, 0, UINT8_MAX, setChannelThreshold<&ChannelConfiguration::off_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::CHANNEL, BANDS, FieldKind::ARRAY, 1, MAX_BANDS, nullptr, FieldScope::BAND, {}},
+            {FieldScope::CHANNEL, FILTER, FieldKind::OBJECT, 0, 0, nullptr, FieldScope::FILTER, {}},
+            {FieldScope::BAND, ON_THRESHOLD, FieldKind::NUMBER, -UNBOUNDED, UNBOUNDED, setBand<&FanBand::on_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::BAND, OFF_THRESHOLD, FieldKind::NUMBER, -UNBOUNDED, UNBOUNDED, setBand<&FanBand::off_threshold>, FieldScope::IGNORED, {}},
+            {FieldScope::BAND, DUTY, FieldKind::UNSIGNED, 1, MAX_DUTY, setBand<&FanBand::duty>, FieldScope::IGNORED, {}},
+            {FieldScope::FILTER, MEDIAN_WINDOW, FieldKind::UNSIGNED, 0, MAX_MEDIAN_WINDOW, setFilter<&SensorFilter::median_window>, FieldScope::IGNORED, {}},
+            {FieldScope::FILTER, SMOOTHING, FieldKind::UNSIGNED, 0, MAX_SMOOTHING, setFilter<&SensorFilter::smoothing>, FieldScope::IGNORED, {}},
+            {FieldScope::FILTER, MAX_STEP, FieldKind::UNSIGNED, 0, UINT32_MAX, setFilter<&SensorFilter::max_step>, FieldScope::IGNORED, {}},
+            {FieldScope::FILTER, MAX_REJECTIONS, FieldKind::UNSIGNED, 1, UNBOUNDED,
+             [](ConfigurationParser& parser, const FieldValue& value) {
+                 parser._filter->max_rejections = static_cast<uint8_t>(std::min<double>(value.number, UINT8_MAX));
+                 return true;
+             },
+             FieldScope::IGNORED, {}},
+        };
+        // clang-format on
+        return FIELDS;
+    }
+
+    /**
+     * Unknown items are ignored, as they always have been.
+     */
+    static const FieldSchema* _find(FieldScope scope, std::string_view key)
+    {
+        for (const auto& field : fields()) {
+            if (field.scope == scope && field.key == key) {
+                return &field;
+            }
         }
+        return nullptr;
     }
 
-    if (configuration.contains(BREATH_BRIGHTNESS)) {
-        if (!configuration[BREATH_BRIGHTNESS].is_number() || configuration[BLINK].get<uint8_t>() > MAX_BRIGHTNESS) {
-            return false;
+    bool _seen(const Frame& frame, std::string_view key) const
+    {
+        const FieldSchema* field = _find(frame.scope, key);
+        return std::find(frame.seen.begin(), frame.seen.end(), field) != frame.seen.end();
+    }
+
+    bool _channelScope() const
+    {
+        return _frames.back().scope == FieldScope::CHANNEL;
+    }
+
+    std::string _path() const
+    {
+        const Frame& frame = _frames.back();
+        if (frame.array) {
+            return fmt::format("{}[{}]", frame.path, frame.index);
         }
+        return frame.path.empty() ? _key : frame.path + "." + _key;
     }
 
-    if (configuration.contains(OUTPUT_FILE)) {
-        if (!configuration[OUTPUT_FILE].is_string()) {
-            return false;
+    void _error(const std::string& path, const std::string& expected)
+    {
+        _errors.push_back(fmt::format("{} must be {}", path, expected));
+    }
+
+    /**
+     * Returns the scope of an array or object starting at the current position, or IGNORED if it is not expected there.
+     */
+    FieldScope _container(FieldKind kind)
+    {
+        const Frame& frame = _frames.back();
+        if (frame.scope == FieldScope::IGNORED) {
+            return FieldScope::IGNORED;
         }
+
+        if (frame.array) {
+            if (kind == FieldKind::OBJECT) {
+                return frame.scope;
+            }
+            _error(_path(), "an object");
+            return FieldScope::IGNORED;
+        }
+
+        if (!_field) {
+            return FieldScope::IGNORED;
+        }
+        if (_field->kind != kind) {
+            _error(_path(), requirement(*_field));
+            return FieldScope::IGNORED;
+        }
+        if (_channelScope()) {
+            ChannelEntry& entry = _channels.back();
+            entry.has_bands = entry.has_bands || _field->contains == FieldScope::BAND;
+            entry.has_filter = entry.has_filter || _field->contains == FieldScope::FILTER;
+        }
+        return _field->contains;
     }
 
-    if (configuration.contains(FORCE_FILE)) {
-        if (!configuration[FORCE_FILE].is_string()) {
-            return false;
+    bool _value(const FieldValue& value)
+    {
+        if (_frames.empty()) {
+            _parsed = true;
+            _errors.push_back("the configuration must be an object");
+            return true;
+        }
+
+        const Frame& frame = _frames.back();
+        if (frame.scope == FieldScope::IGNORED) {
+            return true;
         }
+
+        if (frame.array) {
+            _error(_path(), "an object");
+            _frames.back().index++;
+            return true;
+        }
+
+        if (_field && (!accepts(*_field, value) || !_field->apply(*this, value))) {
+            _error(_path(), requirement(*_field));
+        }
+        return true;
     }
 
-    return true;
-}
+    bool _pop()
+    {
+        _frames.pop_back();
+        if (!_frames.empty() && _frames.back().array) {
+            _frames.back().index++;
+        }
+        return true;
+    }
+
+    void _checkThresholds(const Frame& frame, double on_threshold, double off_threshold, bool required)
+    {
+        bool has_on = _seen(frame, ON_THRESHOLD);
+        bool has_off = _seen(frame, OFF_THRESHOLD);
+        if (has_on != has_off || (required && !has_on)) {
+            _errors.push_back(fmt::format("{}{}on-threshold and off-threshold must be given together", frame.path, frame.path.empty() ? "" : ": "));
+        }
+        else if (has_on && on_threshold < off_threshold) {
+            _errors.push_back(fmt::format("{}{}on-threshold must not be below off-threshold", frame.path, frame.path.empty() ? "" : ": "));
+        }
+    }
+
+    void _endRoot(const Frame& frame)
+    {
+        // Rules for a "valid" configuration, beyond what the schema checks for each item:
+        //      1. It must not be empty.
+        //      2. If it contains On Threshold, it must contain Off Threshold too, and On Threshold must not be less than Off Threshold.
+        if (frame.keys == 0) {
+            _errors.push_back("the configuration is empty");
+        }
+        _checkThresholds(frame, _configuration._on_threshold, _configuration._off_threshold, false);
+    }
+
+    void _endChannel(const Frame& frame)
+    {
+        // Rules for a "valid" channel, beyond what the schema checks for each item:
+        //      1. It must contain Fan Pin.
+        //      2. Clock Pin and Data Pin must be specified as a pair.
+        //      3. Thresholds follow the same rules as the top-level thresholds.
+        //      4. Channel names must be unique.
+        ChannelEntry& entry = _channels.back();
+        ChannelConfiguration& channel = entry.configuration;
+        if (!_seen(frame, FAN_PIN)) {
+            _errors.push_back(fmt::format("{}: fan-pin is required", frame.path));
+        }
+        if (_seen(frame, CLOCK_PIN) != _seen(frame, DATA_PIN)) {
+            _errors.push_back(fmt::format("{}: clock-pin and data-pin must be given together", frame.path));
+        }
+        _checkThresholds(frame, channel.on_threshold, channel.off_threshold, false);
+        entry.has_thresholds = _seen(frame, ON_THRESHOLD);
+
+        if (!_seen(frame, NAME)) {
+            channel.name = "fan" + std::to_string(_channels.size() - 1);
+        }
+        if (!_names.insert(channel.name).second) {
+            _errors.push_back(fmt::format("{}: the name {} is already used", frame.path, channel.name));
+        }
+    }
+
+    void _endBand(const Frame& frame)
+    {
+        // Rules for a valid band, beyond what the schema checks for each item:
+        //      1. It must contain On Threshold and Off Threshold, following the same rules as the top-level thresholds.
+        //      2. Its On Threshold and Off Threshold must be greater than those of the band before it.
+        const FanBand& band = _bands->back();
+        _checkThresholds(frame, band.on_threshold, band.off_threshold, true);
+        if (_bands->size() > 1) {
+            const FanBand& previous = (*_bands)[_bands->size() - 2];
+            if (band.on_threshold <= previous.on_threshold || band.off_threshold <= previous.off_threshold) {
+                _errors.push_back(fmt::format("{}: on-threshold and off-threshold must be above those of the band before it", frame.path));
+            }
+        }
+    }
+
+    Configuration& _configuration;
+    std::vector<Frame> _frames;
+    const FieldSchema* _field;
+    std::string _key;
+    std::vector<ChannelEntry> _channels;
+    std::set<std::string> _names;
+    std::vector<FanBand>* _bands;
+    SensorFilter* _filter;
+    std::vector<std::string> _errors;
+    bool _parsed;
+};
+
 
 Configuration::Configuration() : Configuration(std::filesystem::path(DEFAULT_CONFIGURATION_FILE))
 {}
@@ -100,10 +728,53 @@ Configuration::Configuration(const std::filesystem::path& configuration_file)
       _brightness(DEFAULT_BRIGHTNESS),
       _blink(BlinkType::NO_BLINK),
       _breath_brightness(DEFAULT_BREATH_BRIGHTNESS),
-      _force_file(DEFAULT_PROM_FILE),
-      _output_file(DEFAULT_FORCE_FILE)
+      _force_file(DEFAULT_FORCE_FILE),
+      _output_file(DEFAULT_PROM_FILE),
+      _control_socket(DEFAULT_CONTROL_SOCKET),
+      _status_segment(DEFAULT_STATUS_SEGMENT_NAME),
+      _channels(),
+      _load_threshold(DEFAULT_LOAD_THRESHOLD),
+      _load_duration(DEFAULT_LOAD_DURATION),
+      _load_bias(DEFAULT_LOAD_BIAS),
+      _proc_root(DEFAULT_PROC_ROOT),
+      _sys_root(DEFAULT_SYS_ROOT),
+      _trip_margin(DEFAULT_TRIP_MARGIN),
+      _throttle_fan(false),
+      _rt_priority(DEFAULT_RT_PRIORITY),
+      _rt_cpu(NO_CPU),
+      _rt_lock_memory(true),
+      _pwm_frequency(DEFAULT_PWM_FREQUENCY),
+      _reconcile_interval(DEFAULT_RECONCILE_INTERVAL),
+      _min_on_time(DEFAULT_MIN_ON_TIME),
+      _min_off_time(DEFAULT_MIN_OFF_TIME),
+      _bands(),
+      _filter(),
+      _capture_directory(),
+      _capture_size(DEFAULT_CAPTURE_SIZE),
+      _io_uring(false)
 {
     _load(configuration_file);
+
+    if (_channels.empty()) {
+        // Without explicit channels, the driver controls a single Pimoroni Fan SHIM.
+        ChannelConfiguration channel = {};
+        channel.name = DEFAULT_CHANNEL_NAME;
+        channel.chip = DEFAULT_CHIP_NAME;
+        channel.fan_pin = DEFAULT_FAN_PIN;
+        channel.button_pin = DEFAULT_BUTTON_PIN;
+        channel.clock_pin = DEFAULT_CLOCK_PIN;
+        channel.data_pin = DEFAULT_DATA_PIN;
+        channel.led_count = DEFAULT_LED_COUNT;
+        channel.sensor = DEFAULT_SENSOR_FILE;
+        channel.on_threshold = _on_threshold;
+        channel.off_threshold = _off_threshold;
+        channel.bands = _bands;
+        if (channel.bands.empty()) {
+            channel.bands.push_back({_on_threshold, _off_threshold, MAX_DUTY});
+        }
+        channel.filter = _filter;
+        _channels.push_back(channel);
+    }
 }
 
 double Configuration::onThreshold() const
@@ -146,49 +817,131 @@ const std::filesystem::path& Configuration::outputFile() const
     return _output_file;
 }
 
-void Configuration::_load(const std::filesystem::path& configuration_file)
+const std::filesystem::path& Configuration::controlSocket() const
 {
-    json config;
+    return _control_socket;
+}
 
-    std::ifstream config_stream(configuration_file, std::ios::in);
-    if (!config_stream) {
-        return;
-    }
+const std::string& Configuration::statusSegment() const
+{
+    return _status_segment;
+}
 
-    config = json::parse(config_stream);
-    config_stream.close();
+const std::vector<ChannelConfiguration>& Configuration::channels() const
+{
+    return _channels;
+}
 
-    if (!isValid(config)) {
-        logger().error("Configuration file {} is not valid.", configuration_file.native());
-        return;
-    }
+uint8_t Configuration::loadThreshold() const
+{
+    return _load_threshold;
+}
 
-    if (config.contains(ON_THRESHOLD)) {
-        _on_threshold = config[ON_THRESHOLD].get<uint8_t>();
-        _off_threshold = config[OFF_THRESHOLD].get<uint8_t>();
-    }
+std::chrono::milliseconds Configuration::loadDuration() const
+{
+    return _load_duration;
+}
 
-    if (config.contains(DELAY)) {
-        _delay = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::seconds(config[DELAY].get<uint8_t>()));
-    }
+double Configuration::loadBias() const
+{
+    return _load_bias;
+}
 
-    if (config.contains(BRIGHTNESS)) {
-        _brightness = config[BRIGHTNESS].get<uint8_t>();
-    }
+const std::filesystem::path& Configuration::procRoot() const
+{
+    return _proc_root;
+}
 
-    if (config.contains(BLINK)) {
-        _blink = static_cast<BlinkType>(config[BLINK].get<uint8_t>());
-    }
+const std::filesystem::path& Configuration::sysRoot() const
+{
+    return _sys_root;
+}
 
-    if (config.contains(BREATH_BRIGHTNESS)) {
-        _breath_brightness = config[BREATH_BRIGHTNESS].get<uint8_t>();
-    }
+double Configuration::tripMargin() const
+{
+    return _trip_margin;
+}
+
+bool Configuration::throttleFan() const
+{
+    return _throttle_fan;
+}
+
+uint8_t Configuration::rtPriority() const
+{
+    return _rt_priority;
+}
+
+int32_t Configuration::rtCPU() const
+{
+    return _rt_cpu;
+}
+
+bool Configuration::rtLockMemory() const
+{
+    return _rt_lock_memory;
+}
+
+uint32_t Configuration::pwmFrequency() const
+{
+    return _pwm_frequency;
+}
+
+std::chrono::milliseconds Configuration::reconcileInterval() const
+{
+    return _reconcile_interval;
+}
+
+std::chrono::milliseconds Configuration::minOnTime() const
+{
+    return _min_on_time;
+}
+
+std::chrono::milliseconds Configuration::minOffTime() const
+{
+    return _min_off_time;
+}
 
-    if (config.contains(OUTPUT_FILE)) {
-        _output_file = std::filesystem::path(config[OUTPUT_FILE].get<std::string>());
+const SensorFilter& Configuration::filter() const
+{
+    return _filter;
+}
+
+const std::filesystem::path& Configuration::captureDirectory() const
+{
+    return _capture_directory;
+}
+
+size_t Configuration::captureSize() const
+{
+    return _capture_size;
+}
+
+bool Configuration::ioUring() const
+{
+    return _io_uring;
+}
+
+void Configuration::_load(const std::filesystem::path& configuration_file)
+{
+    std::ifstream config_stream(configuration_file, std::ios::in);
+    if (!config_stream) {
+        return;
     }
 
-    if (config.contains(FORCE_FILE)) {
-        _force_file = std::filesystem::path(config[FORCE_FILE].get<std::string>());
+    // Parsed into a copy, so that an invalid file leaves every default in place.
+    Configuration parsed(*this);
+    ConfigurationParser parser(parsed);
+    json::sax_parse(config_stream, &parser);
+    config_stream.close();
+
+    if (!parser.finish()) {
+        for (const auto& error : parser.errors()) {
+            logger().error("{}: {}", configuration_file.native(), error);
+        }
+        logger().error("Configuration file {} is not valid.", configuration_file.native());
+        return;
     }
+
+    *this = std::move(parsed);
 }
@@ -6,15 +6,51 @@
 #include <map>
 #include <string>
 #include <string_view>
+#include <vector>
 
 inline constexpr std::string_view DEFAULT_CONFIGURATION_FILE = "/etc/fanshim.json";
 inline constexpr std::string_view DEFAULT_FORCE_FILE = "/usr/local/etc/.force_fanshim";
 inline constexpr std::string_view DEFAULT_PROM_FILE = "/usr/local/etc/node_exp_txt/cpu_fan.prom";
+inline constexpr std::string_view DEFAULT_CONTROL_SOCKET = "/run/fanshim.sock";
+inline constexpr std::string_view DEFAULT_STATUS_SEGMENT_NAME = "/fanshim";
 inline constexpr uint8_t DEFAULT_ON_THRESHOLD = 60;
 inline constexpr uint8_t DEFAULT_OFF_THRESHOLD = 50;
 inline constexpr std::chrono::milliseconds DEFAULT_DELAY = std::chrono::milliseconds(10000);
 inline constexpr uint8_t DEFAULT_BRIGHTNESS = 0;
 inline constexpr uint8_t DEFAULT_BREATH_BRIGHTNESS = 10;
+inline constexpr std::string_view DEFAULT_CHANNEL_NAME = "fanshim";
+inline constexpr std::string_view DEFAULT_CHIP_NAME = "gpiochip0";
+inline constexpr std::string_view DEFAULT_SENSOR_FILE = "/sys/class/thermal/thermal_zone0/temp";
+inline constexpr int32_t DEFAULT_FAN_PIN = 18;
+inline constexpr int32_t DEFAULT_BUTTON_PIN = 17;
+inline constexpr int32_t DEFAULT_CLOCK_PIN = 14;
+inline constexpr int32_t DEFAULT_DATA_PIN = 15;
+inline constexpr int32_t NO_PIN = -1;
+inline constexpr size_t MAX_CHANNELS = 8;
+inline constexpr std::string_view DEFAULT_PROC_ROOT = "/proc";
+inline constexpr uint8_t DEFAULT_LOAD_THRESHOLD = 0;
+inline constexpr std::chrono::milliseconds DEFAULT_LOAD_DURATION = std::chrono::milliseconds(5000);
+inline constexpr uint8_t DEFAULT_LOAD_BIAS = 10;
+inline constexpr uint8_t MAX_LOAD_THRESHOLD = 100;
+inline constexpr std::string_view DEFAULT_SYS_ROOT = "/sys";
+inline constexpr uint8_t DEFAULT_TRIP_MARGIN = 5;
+inline constexpr uint8_t DEFAULT_RT_PRIORITY = 0;
+inline constexpr uint8_t MAX_RT_PRIORITY = 99;
+inline constexpr int32_t NO_CPU = -1;
+inline constexpr uint32_t DEFAULT_PWM_FREQUENCY = 50;
+inline constexpr uint32_t MAX_PWM_FREQUENCY = 1000;
+inline constexpr std::chrono::milliseconds DEFAULT_RECONCILE_INTERVAL = std::chrono::milliseconds(0);
+inline constexpr std::chrono::milliseconds DEFAULT_MIN_ON_TIME = std::chrono::milliseconds(0);
+inline constexpr std::chrono::milliseconds DEFAULT_MIN_OFF_TIME = std::chrono::milliseconds(0);
+inline constexpr size_t MAX_BANDS = 8;
+inline constexpr uint8_t MAX_DUTY = 100;
+inline constexpr uint8_t MAX_MEDIAN_WINDOW = 9;
+inline constexpr uint8_t MAX_SMOOTHING = 99;
+inline constexpr uint8_t DEFAULT_MAX_REJECTIONS = 3;
+inline constexpr uint16_t DEFAULT_LED_COUNT = 1;
+inline constexpr uint16_t MAX_LED_COUNT = 1024;
+inline constexpr size_t DEFAULT_CAPTURE_SIZE = 65536;
+inline constexpr size_t MAX_CAPTURE_SIZE = 16 * 1024 * 1024;
 
 enum class BlinkType : uint8_t
 {
@@ -23,6 +59,51 @@ enum class BlinkType : uint8_t
     BREATHE = 2
 };
 
+/**
+ * The fan runs at `duty` percent once the temperature reaches `on_threshold`, until it falls below `off_threshold`.
+ */
+struct FanBand
+{
+    double on_threshold;
+    double off_threshold;
+    uint8_t duty;
+};
+
+/**
+ * How a channel's temperature samples are filtered, see TemperatureFilter. Each stage is disabled at 0.
+ */
+struct SensorFilter
+{
+    uint8_t median_window;
+    uint8_t smoothing;
+    double max_step;
+    uint8_t max_rejections;
+};
+
+struct ChannelConfiguration
+{
+    std::string name;
+    std::string chip;
+    int32_t fan_pin;
+    int32_t button_pin;
+    int32_t clock_pin;
+    int32_t data_pin;
+
+    /**
+     * The number of APA102 LEDs chained on the clock and data lines.
+     */
+    uint16_t led_count;
+    std::filesystem::path sensor;
+    double on_threshold;
+    double off_threshold;
+
+    /**
+     * Ordered by ascending `on_threshold`; the first band's thresholds are `on_threshold` and `off_threshold`.
+     */
+    std::vector<FanBand> bands;
+    SensorFilter filter;
+};
+
 struct Configuration
 {
 public:
@@ -37,8 +118,31 @@ public:
     uint8_t breathBrightness() const;
     const std::filesystem::path& forceFile() const;
     const std::filesystem::path& outputFile() const;
+    const std::filesystem::path& controlSocket() const;
+    const std::string& statusSegment() const;
+    const std::vector<ChannelConfiguration>& channels() const;
+    uint8_t loadThreshold() const;
+    std::chrono::milliseconds loadDuration() const;
+    double loadBias() const;
+    const std::filesystem::path& procRoot() const;
+    const std::filesystem::path& sysRoot() const;
+    double tripMargin() const;
+    bool throttleFan() const;
+    uint8_t rtPriority() const;
+    int32_t rtCPU() const;
+    bool rtLockMemory() const;
+    uint32_t pwmFrequency() const;
+    std::chrono::milliseconds reconcileInterval() const;
+    std::chrono::milliseconds minOnTime() const;
+    std::chrono::milliseconds minOffTime() const;
+    const SensorFilter& filter() const;
+    const std::filesystem::path& captureDirectory() const;
+    size_t captureSize() const;
+    bool ioUring() const;
 
 private:
+    friend class ConfigurationParser;
+
     void _load(const std::filesystem::path& configuration_file);
 
     double _on_threshold;
@@ -49,4 +153,26 @@ private:
     uint8_t _breath_brightness;
     std::filesystem::path _force_file;
     std::filesystem::path _output_file;
+    std::filesystem::path _control_socket;
+    std::string _status_segment;
+    std::vector<ChannelConfiguration> _channels;
+    uint8_t _load_threshold;
+    std::chrono::milliseconds _load_duration;
+    double _load_bias;
+    std::filesystem::path _proc_root;
+    std::filesystem::path _sys_root;
+    double _trip_margin;
+    bool _throttle_fan;
+    uint8_t _rt_priority;
+    int32_t _rt_cpu;
+    bool _rt_lock_memory;
+    uint32_t _pwm_frequency;
+    std::chrono::milliseconds _reconcile_interval;
+    std::chrono::milliseconds _min_on_time;
+    std::chrono::milliseconds _min_off_time;
+    std::vector<FanBand> _bands;
+    SensorFilter _filter;
+    std::filesystem::path _capture_directory;
+    size_t _capture_size;
+    bool _io_uring;
 };
@@ -0,0 +1,524 @@
+#include "fanshim/control.hpp"
+
+#include "fanshim/channel.hpp"
+#include "fanshim/driver.hpp"
+#include "fanshim/logger.hpp"
+
+#include <spdlog/fmt/fmt.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+
+inline constexpr int32_t CONNECTION_BACKLOG = 8;
+inline constexpr std::string_view UNKNOWN_COMMAND = "err unknown command\n";
+
+
+static std::string_view nextToken(std::string_view& line)
+{
+    size_t start = line.find_first_not_of(' ');
+    if (start == std::string_view::npos) {
+        line = std::string_view();
+        return line;
+    }
+
+    line.remove_prefix(start);
+    size_t end = line.find(' ');
+    std::string_view token = line.substr(0, end);
+    line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+    return token;
+}
+
+static bool parseLogLevel(std::string_view name, LogLevel& level)
+{
+    if (name == "debug") {
+        level = LogLevel::DEBUG;
+    }
+    else if (name == "info") {
+        level = LogLevel::INFO;
+    }
+    else if (name == "warn") {
+        level = LogLevel::WARN;
+    }
+    else if (name == "error") {
+        level = LogLevel::ERROR;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+static std::string_view forceName(ForceState state)
+{
+    switch (state) {
+    case ForceState::ON:
+        return "on";
+    case ForceState::OFF:
+        return "off";
+    case ForceState::NONE:
+    default:
+        return "none";
+    }
+}
+
+template <typename... Args>
+static size_t respond(char* response, size_t capacity, const char* fmt, const Args&... args)
+{
+    auto result = fmt::format_to_n(response, capacity, fmt, args...);
+    return std::min(result.size, capacity);
+}
+
+template <typename... Args>
+static void append(char* response, size_t capacity, size_t& length, const char* fmt, const Args&... args)
+{
+    length += respond(response + length, capacity - length, fmt, args...);
+}
+
+ControlServer::ControlServer(uv_loop_t* loop, Driver& driver)
+    : _loop(loop), _server(), _driver(driver), _path(), _clients(), _on_closed(), _open_handles(0), _listening(false)
+{}
+
+ControlServer::~ControlServer()
+{
+    stop();
+}
+
+int32_t ControlServer::start(const std::filesystem::path& socket_path)
+{
+    std::error_code ec;
+    if (socket_path.empty()) {
+        logger().debug("Control socket disabled");
+        return 0;
+    }
+
+    // A previous instance that did not shut down cleanly leaves the socket file behind, which would cause the bind to fail.
+    std::filesystem::remove(socket_path, ec);
+
+    int32_t result = uv_pipe_init(_loop, &_server, 0);
+    if (result) {
+        logger().error("Failed to initialize control socket: {}", uv_strerror(result));
+        return result;
+    }
+
+    _open_handles++;
+    _server.data = this;
+    result = uv_pipe_bind(&_server, socket_path.c_str());
+    if (result) {
+        logger().error("Failed to bind control socket {}: {}", socket_path.native(), uv_strerror(result));
+        uv_close(reinterpret_cast<uv_handle_t*>(&_server), _onServerClosed);
+        return result;
+    }
+
+    result = uv_listen(reinterpret_cast<uv_stream_t*>(&_server), CONNECTION_BACKLOG, _onConnection);
+    if (result) {
+        logger().error("Failed to listen on control socket {}: {}", socket_path.native(), uv_strerror(result));
+        uv_close(reinterpret_cast<uv_handle_t*>(&_server), _onServerClosed);
+        return result;
+    }
+
+    _path = socket_path;
+    _listening = true;
+    logger().warn("Control socket listening on {}", _path.native());
+    return 0;
+}
+
+void ControlServer::stop()
+{
+    std::error_code ec;
+    if (!_listening) {
+        return;
+    }
+
+    _listening = false;
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t*>(&_server))) {
+        uv_close(reinterpret_cast<uv_handle_t*>(&_server), _onServerClosed);
+    }
+    std::filesystem::remove(_path, ec);
+}
+
+void ControlServer::close(CloseCallback callback)
+{
+    stop();
+
+    _on_closed = std::move(callback);
+    for (Client* client : _clients) {
+        if (!uv_is_closing(reinterpret_cast<uv_handle_t*>(&client->handle))) {
+            uv_close(reinterpret_cast<uv_handle_t*>(&client->handle), _onClientClosed);
+        }
+    }
+
+    if (_open_handles == 0 && _on_closed) {
+        _on_closed();
+    }
+}
+
+bool ControlServer::_selectChannels(std::string_view name, Channel*& selected) const
+{
+    // An empty name addresses every channel.
+    selected = nullptr;
+    if (name.empty()) {
+        return true;
+    }
+
+    selected = _driver.channel(name);
+    return selected != nullptr;
+}
+
+size_t ControlServer::_handleRequest(std::string_view request, char* response, size_t capacity)
+{
+    std::string_view command = nextToken(request);
+    Channel* selected = nullptr;
+    size_t length = 0;
+
+    if (command == "channels") {
+        append(response, capacity, length, "ok");
+        for (const auto& channel : _driver.channels()) {
+            append(response, capacity, length, " {}", channel->name());
+        }
+        append(response, capacity, length, "\n");
+        return length;
+    }
+
+    if (command == "temp" || command == "fan" || command == "state") {
+        if (!_selectChannels(nextToken(request), selected)) {
+            return respond(response, capacity, "err unknown channel\n");
+        }
+
+        append(response, capacity, length, "ok");
+        for (const auto& channel : _driver.channels()) {
+            if (selected && selected != channel.get()) {
+                continue;
+            }
+
+            if (command == "temp") {
+                append(response, capacity, length, " {:.3f}", channel->temperature());
+            }
+            else if (command == "fan") {
+                append(response, capacity, length, " {}", channel->fan() ? "on" : "off");
+            }
+            else {
+                append(response,
+                       capacity,
+                       length,
+                       "{}channel={} fan={} duty={} band={} temp={:.3f} raw-temp={:.3f} button={:d} override={:d} temperature-lock={:d} force={} force-ttl={} transitions={} dwell-holds={} reads-saved={} mismatches={}",
+                       length > 2 ? "; " : " ",
+                       channel->name(),
+                       channel->fan() ? "on" : "off",
+                       channel->duty(),
+                       channel->band(),
+                       channel->temperature(),
+                       channel->rawTemperature(),
+                       channel->button(),
+                       channel->overrideActive(),
+                       channel->temperatureActive(),
+                       forceName(channel->forceState()),
+                       channel->forceRemaining().count(),
+                       channel->stats().fan_transitions,
+                       channel->stats().dwell_holds,
+                       channel->gpioStats().reads_saved,
+                       channel->gpioStats().mismatches);
+            }
+        }
+        append(response, capacity, length, "\n");
+        return length;
+    }
+
+    if (command == "stats") {
+        const DriverStats& stats = _driver.stats();
+        return respond(response,
+                       capacity,
+                       "ok temperature={}/{}/{} override={}/{}/{} button={}/{}/{} led={}/{}/{} load={}/{}/{} throttle={}/{}/{} reconcile={}/{}/{}\n",
+                       stats.temperature.runs,
+                       stats.temperature.averageNs(),
+                       stats.temperature.max_ns,
+                       stats.override_check.runs,
+                       stats.override_check.averageNs(),
+                       stats.override_check.max_ns,
+                       stats.button.runs,
+                       stats.button.averageNs(),
+                       stats.button.max_ns,
+                       stats.led.runs,
+                       stats.led.averageNs(),
+                       stats.led.max_ns,
+                       stats.load.runs,
+                       stats.load.averageNs(),
+                       stats.load.max_ns,
+                       stats.throttle.runs,
+                       stats.throttle.averageNs(),
+                       stats.throttle.max_ns,
+                       stats.reconcile.runs,
+                       stats.reconcile.averageNs(),
+                       stats.reconcile.max_ns);
+    }
+
+    if (command == "load") {
+        const LoadMonitor& load = _driver.load();
+        if (!load.isOpen()) {
+            return respond(response, capacity, "err load monitoring disabled\n");
+        }
+        return respond(response, capacity, "ok utilisation={:.1f} load-average={:.2f} high={:d}\n", load.utilisation(), load.loadAverage(), load.high());
+    }
+
+    if (command == "realtime") {
+        const RealtimeWorker* realtime = _driver.realtime();
+        if (!realtime) {
+            return respond(response, capacity, "err realtime worker disabled\n");
+        }
+
+        RealtimeStatus status = realtime->status();
+        return respond(response,
+                       capacity,
+                       "ok running={:d} fifo={:d} pinned={:d} locked={:d} wakeups={} lateness-avg-ns={} lateness-max-ns={} dropped={}\n",
+                       status.running,
+                       status.fifo,
+                       status.pinned,
+                       status.locked,
+                       status.wakeups,
+                       status.average_lateness_ns,
+                       status.max_lateness_ns,
+                       status.dropped);
+    }
+
+    if (command == "throttle") {
+        const ThrottleMonitor& throttle = _driver.throttle();
+        if (!throttle.isOpen()) {
+            return respond(response, capacity, "err throttle monitoring unavailable\n");
+        }
+        return respond(response,
+                       capacity,
+                       "ok throttled={:d} frequency={:.3f} throttled-s={:.1f} events={}\n",
+                       throttle.throttled(),
+                       throttle.frequencyRatio(),
+                       throttle.throttledTime().count() / 1000.0,
+                       throttle.throttleEvents());
+    }
+
+    if (command == "force") {
+        std::string_view state = nextToken(request);
+        if (state == "clear") {
+            if (!_selectChannels(nextToken(request), selected)) {
+                return respond(response, capacity, "err unknown channel\n");
+            }
+
+            for (const auto& channel : _driver.channels()) {
+                if (!selected || selected == channel.get()) {
+                    channel->clearForce();
+                }
+            }
+            _driver.publishStatus();
+            return respond(response, capacity, "ok\n");
+        }
+
+        std::string_view ttl_token = nextToken(request);
+        uint32_t ttl = 0;
+        auto [end, ec] = std::from_chars(ttl_token.data(), ttl_token.data() + ttl_token.size(), ttl);
+        if ((state != "on" && state != "off") || ec != std::errc() || end != ttl_token.data() + ttl_token.size() || ttl == 0) {
+            return respond(response, capacity, "err usage: force <on|off> <ttl-seconds> [channel] | force clear [channel]\n");
+        }
+
+        if (!_selectChannels(nextToken(request), selected)) {
+            return respond(response, capacity, "err unknown channel\n");
+        }
+
+        for (const auto& channel : _driver.channels()) {
+            if (!selected || selected == channel.get()) {
+                channel->force(state == "on", std::chrono::seconds(ttl));
+            }
+        }
+        _driver.publishStatus();
+        return respond(response, capacity, "ok\n");
+    }
+
+    if (command == "startup") {
+        const StartupTimeline& startup = startupTimeline();
+        if (!startup.reached(StartupPhase::FIRST_CONTROL)) {
+            return respond(response, capacity, "err no control action yet\n");
+        }
+
+        return respond(response,
+                       capacity,
+                       "ok logger-ns={} configuration-ns={} driver-ns={} timers-ns={} serve-ns={} first-control-ns={} time-to-control-ns={}\n",
+                       startup.durationNs(StartupPhase::LOGGER),
+                       startup.durationNs(StartupPhase::CONFIGURATION),
+                       startup.durationNs(StartupPhase::DRIVER),
+                       startup.durationNs(StartupPhase::TIMERS),
+                       startup.durationNs(StartupPhase::SERVE),
+                       startup.durationNs(StartupPhase::FIRST_CONTROL),
+                       startup.elapsedNs(StartupPhase::FIRST_CONTROL));
+    }
+
+    if (command == "capture") {
+        if (!_selectChannels(nextToken(request), selected)) {
+            return respond(response, capacity, "err unknown channel\n");
+        }
+
+        for (const auto& channel : _driver.channels()) {
+            if ((!selected || selected == channel.get()) && !_driver.capture(*channel)) {
+                return respond(response, capacity, "err capture disabled\n");
+            }
+        }
+
+        // Writing the dump would block the loop for as long as the capture is large, so it is left to stop() and only the summary is reported here.
+        append(response, capacity, length, "ok");
+        for (const auto& channel : _driver.channels()) {
+            if (selected && selected != channel.get()) {
+                continue;
+            }
+
+            const CaptureBackend* capture = _driver.capture(*channel);
+            CaptureTiming timing = capture->timing();
+            append(response,
+                   capacity,
+                   length,
+                   "{}channel={} transitions={} dropped={} clock-edges={} frames={} period-ns={}/{}/{} jitter-ns={} frame-ns={}",
+                   length > 2 ? "; " : " ",
+                   channel->name(),
+                   capture->size(),
+                   capture->dropped(),
+                   timing.clock_edges,
+                   timing.frames,
+                   timing.min_period_ns,
+                   timing.mean_period_ns,
+                   timing.max_period_ns,
+                   timing.jitter_ns,
+                   timing.mean_frame_ns);
+        }
+        append(response, capacity, length, "\n");
+        return length;
+    }
+
+    if (command == "log") {
+        LogLevel level = LogLevel::WARN;
+        if (!parseLogLevel(nextToken(request), level)) {
+            return respond(response, capacity, "err usage: log <debug|info|warn|error>\n");
+        }
+
+        logger().setLevel(level);
+        return respond(response, capacity, "ok\n");
+    }
+
+    return respond(response, capacity, "{}", UNKNOWN_COMMAND);
+}
+
+void ControlServer::_respond(Client* client, std::string_view request)
+{
+    char response[CONTROL_RESPONSE_SIZE];
+
+    if (!request.empty() && request.back() == '\r') {
+        request.remove_suffix(1);
+    }
+
+    size_t length = _handleRequest(request, response, sizeof(response));
+    if (length == 0 || response[length - 1] != '\n') {
+        // Clients read a line at a time; a truncated response must still end one.
+        length = std::min(length + 1, sizeof(response));
+        response[length - 1] = '\n';
+    }
+    uv_buf_t buffer = uv_buf_init(response, static_cast<uint32_t>(length));
+
+    // Responses are far smaller than the socket buffer, so a non-blocking write completes immediately and avoids a request allocation.
+    int32_t result = uv_try_write(reinterpret_cast<uv_stream_t*>(&client->handle), &buffer, 1);
+    if (result < 0 || static_cast<size_t>(result) != length) {
+        logger().warn("Failed to write control response, closing client");
+        uv_close(reinterpret_cast<uv_handle_t*>(&client->handle), _onClientClosed);
+    }
+}
+
+void ControlServer::_onAllocate(uv_handle_t* handle, size_t /* unused */, uv_buf_t* buffer)
+{
+    Client* client = static_cast<Client*>(handle->data);
+    *buffer = uv_buf_init(client->buffer + client->length, static_cast<uint32_t>(CONTROL_BUFFER_SIZE - client->length));
+}
+
+void ControlServer::_handleClosed()
+{
+    if (--_open_handles == 0 && _on_closed) {
+        _on_closed();
+    }
+}
+
+void ControlServer::_onClientClosed(uv_handle_t* handle)
+{
+    Client* client = static_cast<Client*>(handle->data);
+    ControlServer* self = client->server;
+    self->_clients.erase(std::find(self->_clients.begin(), self->_clients.end(), client));
+    delete client;
+    self->_handleClosed();
+}
+
+void ControlServer::_onServerClosed(uv_handle_t* handle)
+{
+    static_cast<ControlServer*>(handle->data)->_handleClosed();
+}
+
+void ControlServer::_onConnection(uv_stream_t* server, int32_t status)
+{
+    ControlServer* self = static_cast<ControlServer*>(server->data);
+    if (status < 0) {
+        logger().error("Control socket connection failed: {}", uv_strerror(status));
+        return;
+    }
+
+    Client* client = new Client();
+    client->server = self;
+    client->length = 0;
+    uv_pipe_init(self->_loop, &client->handle, 0);
+    client->handle.data = client;
+    self->_clients.push_back(client);
+    self->_open_handles++;
+
+    if (uv_accept(server, reinterpret_cast<uv_stream_t*>(&client->handle)) != 0) {
+        uv_close(reinterpret_cast<uv_handle_t*>(&client->handle), _onClientClosed);
+        return;
+    }
+
+    uv_read_start(reinterpret_cast<uv_stream_t*>(&client->handle), _onAllocate, _onRead);
+}
+
+void ControlServer::_onRead(uv_stream_t* stream, ssize_t count, const uv_buf_t* /* unused */)
+{
+    Client* client = static_cast<Client*>(stream->data);
+
+    if (count == UV_ENOBUFS) {
+        // The buffer filled up without a newline; the request can never be answered, so discard it.
+        static constexpr std::string_view TOO_LONG = "err request too long\n";
+        uv_buf_t buffer = uv_buf_init(const_cast<char*>(TOO_LONG.data()), static_cast<uint32_t>(TOO_LONG.size()));
+        uv_try_write(stream, &buffer, 1);
+        client->length = 0;
+        return;
+    }
+
+    if (count < 0) {
+        if (count != UV_EOF) {
+            logger().debug("Control client read failed: {}", uv_strerror(static_cast<int32_t>(count)));
+        }
+        uv_close(reinterpret_cast<uv_handle_t*>(stream), _onClientClosed);
+        return;
+    }
+
+    client->length += static_cast<size_t>(count);
+
+    size_t consumed = 0;
+    for (size_t i = 0; i < client->length; ++i) {
+        if (client->buffer[i] != '\n') {
+            continue;
+        }
+
+        client->server->_respond(client, std::string_view(client->buffer + consumed, i - consumed));
+        if (uv_is_closing(reinterpret_cast<uv_handle_t*>(stream))) {
+            return;
+        }
+        consumed = i + 1;
+    }
+
+    std::memmove(client->buffer, client->buffer + consumed, client->length - consumed);
+    client->length -= consumed;
+}
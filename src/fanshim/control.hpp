@@ -0,0 +1,83 @@
+#pragma once
+
+#include "fanshim/configuration.hpp"
+
+#include <uv.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+
+inline constexpr size_t CONTROL_BUFFER_SIZE = 256;
+inline constexpr size_t CONTROL_CHANNEL_RESPONSE_SIZE = 384;
+inline constexpr size_t CONTROL_RESPONSE_SIZE = CONTROL_BUFFER_SIZE + MAX_CHANNELS * CONTROL_CHANNEL_RESPONSE_SIZE;
+
+class Channel;
+class Driver;
+
+/**
+ * Serves a line-oriented request/response protocol over a Unix domain socket on the driver's event loop.
+ *
+ * Each request is a single newline-terminated line and is answered with a single line starting with either `ok` or `err`. The response buffer holds a
+ * `state` or `capture` line for every channel; a response that would not fit is cut short but still ends with a newline.
+ */
+class ControlServer
+{
+public:
+    using CloseCallback = std::function<void()>;
+
+    ControlServer(uv_loop_t* loop, Driver& driver);
+    ~ControlServer();
+
+    int32_t start(const std::filesystem::path& socket_path);
+
+    /**
+     * Stops listening; clients already connected are still served.
+     */
+    void stop();
+
+    /**
+     * Stops listening and closes every client, calling `callback` once the loop has closed the socket and all of them. The server must not be destroyed
+     * before then.
+     */
+    void close(CloseCallback callback);
+
+private:
+    struct Client
+    {
+        uv_pipe_t handle;
+        ControlServer* server;
+        char buffer[CONTROL_BUFFER_SIZE];
+        size_t length;
+    };
+
+    ControlServer(const ControlServer&) = delete;
+    ControlServer(ControlServer&&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+    ControlServer& operator=(ControlServer&&) = delete;
+
+    bool _selectChannels(std::string_view name, Channel*& selected) const;
+    size_t _handleRequest(std::string_view request, char* response, size_t capacity);
+    void _respond(Client* client, std::string_view request);
+
+    void _handleClosed();
+
+    static void _onAllocate(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buffer);
+    static void _onClientClosed(uv_handle_t* handle);
+    static void _onServerClosed(uv_handle_t* handle);
+    static void _onConnection(uv_stream_t* server, int32_t status);
+    static void _onRead(uv_stream_t* stream, ssize_t count, const uv_buf_t* buffer);
+
+    uv_loop_t* _loop;
+    uv_pipe_t _server;
+    Driver& _driver;
+    std::filesystem::path _path;
+    std::vector<Client*> _clients;
+    CloseCallback _on_closed;
+    uint32_t _open_handles;
+    bool _listening;
+};
@@ -0,0 +1,89 @@
+#include "fanshim/controller.hpp"
+
+#include "fanshim/configuration.hpp"
+#include "fanshim/driver.hpp"
+#include "fanshim/logger.hpp"
+#include "fanshim/sensor.hpp"
+
+#include <uv.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+static std::unique_ptr<TemperatureSource> noSensor(const ChannelConfiguration& /* unused */)
+{
+    return nullptr;
+}
+
+static std::unique_ptr<Configuration> loadConfiguration(const ControllerOptions& options)
+{
+    // The logger is created by the first thing logged, which may be the configuration itself.
+    if (options.host_logger) {
+        LoggingContext::useHostLogger();
+    }
+    return std::make_unique<Configuration>(options.configuration_file);
+}
+
+
+FanController::FanController(uv_loop_t* loop, const ControllerOptions& options)
+    : _configuration(loadConfiguration(options)),
+      _driver(std::make_unique<Driver>(*_configuration,
+                                       loop,
+                                       GpiodBackend::create,
+                                       nullptr,
+                                       options.external_sensors ? TemperatureSource::Factory(noSensor) : TemperatureSource::Factory(FileTemperatureSource::create))),
+      _serve(options.serve)
+{}
+
+FanController::~FanController() = default;
+
+void FanController::start()
+{
+    _driver->start();
+    if (_serve) {
+        _driver->serve();
+    }
+    logger().warn("Fan controller started with {} channel(s)", _driver->channels().size());
+}
+
+void FanController::stop()
+{
+    _driver->stop();
+}
+
+void FanController::close(CloseCallback callback)
+{
+    _driver->close(std::move(callback));
+}
+
+std::vector<std::string> FanController::channels() const
+{
+    std::vector<std::string> names;
+    for (const auto& channel : _driver->channels()) {
+        names.push_back(channel->name());
+    }
+    return names;
+}
+
+bool FanController::feedTemperature(std::string_view channel, double temperature)
+{
+    return _driver->feedTemperature(channel, temperature);
+}
+
+bool FanController::status(std::string_view name, ControllerStatus& status) const
+{
+    const Channel* channel = _driver->channel(name);
+    if (!channel) {
+        return false;
+    }
+
+    status.temperature = channel->temperature();
+    status.raw_temperature = channel->rawTemperature();
+    status.duty = channel->duty();
+    status.fan = channel->fan();
+    return true;
+}
@@ -1,278 +1,570 @@
 #include "fanshim/driver.hpp"
 
-#include "fanshim/context.hpp"
-#include "fanshim/gpio.hpp"
 #include "fanshim/logger.hpp"
+#include "fanshim/metrics.hpp"
 
 #include <uv.h>
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
-#include <cmath>
 #include <cstdint>
-#include <fstream>
-#include <functional>
+#include <filesystem>
+#include <memory>
 #include <string_view>
-#include <thread>
+#include <utility>
 
-namespace args = std::placeholders;
 
-inline constexpr std::string_view TEMPERATURE_FILE_PATH = "/sys/class/thermal/thermal_zone0/temp";
-inline constexpr std::string_view FAN_HEADER = "# HELP cpu_fanshim text file output: fan state.\n# TYPE cpu_fanshim gauge\ncpu_fanshim ";
-inline constexpr std::string_view TEMP_HEADER = "# HELP cpu_temp_fanshim text file output: temp.\n# TYPE cpu_temp_fanshim gauge\ncpu_temp_fanshim ";
 inline constexpr std::chrono::milliseconds OVERRIDE_RATE = std::chrono::milliseconds(2000);
 inline constexpr std::chrono::milliseconds BUTTON_RATE = std::chrono::milliseconds(500);
 inline constexpr std::chrono::milliseconds LED_RATE = std::chrono::milliseconds(150);
-inline constexpr double DEFAULT_TEMPERATURE = 25.0;
-inline constexpr double S = 1.0;
+inline constexpr std::chrono::milliseconds LOAD_RATE = std::chrono::milliseconds(1000);
+inline constexpr std::chrono::milliseconds THROTTLE_RATE = std::chrono::milliseconds(1000);
 
+static_assert(MAX_CHANNELS <= STATUS_MAX_CHANNELS, "Every channel must fit in the status segment");
 
-static double getCPUTemperature()
+
+Driver::Driver(const Configuration& configuration, uv_loop_t* loop, GPIOBackend::Factory backend_factory, Clock* clock, TemperatureSource::Factory sensor_factory)
+    : _event_loop(loop),
+      _loop_clock(loop),
+      _clock(clock ? *clock : _loop_clock),
+      _sigint_handle(),
+      _temperature_task(loop, _clock, *this),
+      _override_task(loop, _clock, *this),
+      _button_task(loop, _clock, *this),
+      _led_task(loop, _clock, *this),
+      _load_task(loop, _clock, *this),
+      _throttle_task(loop, _clock, *this),
+      _reconcile_task(loop, _clock, *this),
+      _config(configuration),
+      _control(_event_loop, *this),
+      _publisher(),
+      _metrics(_config.outputFile()),
+      _load(configuration.procRoot(), configuration.loadThreshold(), configuration.loadDuration()),
+      _throttle(configuration.sysRoot()),
+      _stats(),
+      _realtime(),
+      _sampler(),
+      _channels(),
+      _captures(),
+      _breath_values(),
+      _on_closed(),
+      _closing_handles(0),
+      _led_ticks(0),
+      _deferred_started(false),
+      _closing(false),
+      _closed(false)
 {
-    std::ifstream stream(TEMPERATURE_FILE_PATH.data(), std::ios::in);
-    if (!stream) {
-        logger().error("Failed to read CPU Temperature");
-        return DEFAULT_TEMPERATURE;
-    }
+    StartupTimeline& startup = startupTimeline();
+    uv_signal_init(_event_loop, &_sigint_handle);
+    _sigint_handle.data = this;
 
-    std::string contents;
-    std::getline(stream, contents);
-    stream.close();
+    if (_config.rtPriority() > 0) {
+        _realtime = std::make_unique<RealtimeWorker>(_config.rtPriority(), _config.rtCPU(), _config.rtLockMemory(), _config.pwmFrequency());
+    }
 
-    try {
-        return std::stoi(contents) / 1000.0;
+    if (_config.ioUring()) {
+        _sampler = std::make_unique<AttributeSampler>(_event_loop, true);
     }
-    catch (const std::exception& ex) {
-        logger().error("Failed to convert CPU Temperature");
-        return DEFAULT_TEMPERATURE;
+
+    for (const auto& channel : _config.channels()) {
+        std::unique_ptr<GPIOBackend> backend = backend_factory(channel);
+        _captures.push_back(nullptr);
+        if (!_config.captureDirectory().empty()) {
+            auto capture = std::make_unique<CaptureBackend>(std::move(backend), _config.captureSize());
+            _captures.back() = capture.get();
+            backend = std::move(capture);
+        }
+
+        // Only sensor files join the batch; sources supplied by the host, such as simulated ones, are still read one at a time.
+        std::unique_ptr<TemperatureSource> sensor = sensor_factory(channel);
+        if (_sampler && dynamic_cast<FileTemperatureSource*>(sensor.get())) {
+            sensor = std::make_unique<SampledTemperatureSource>(*_sampler, _sampler->add(channel.sensor));
+        }
+
+        _channels.push_back(std::make_unique<Channel>(_event_loop, _clock, channel, _config, std::move(backend), std::move(sensor), _realtime.get()));
+        _channels.back()->onFanChange([this]() { _wakeLED(); });
     }
-}
 
-static double hsvk(int32_t n, double hue)
-{
-    return std::fmod(n + hue / 60.0, 6);
+    startup.mark(StartupPhase::DRIVER);
 }
 
-static double hsvf(int n, double hue, double s, double v)
+Driver::~Driver()
 {
-    double k = hsvk(n, hue);
-    return v - v * s * std::max({std::min({k, 4 - k, 1.0}), 0.0});
+    // Every handle is linked into the loop until its close callback has run.
+    assert(_closed && "Driver::close() must complete before the driver is destroyed");
+    if (!_closed) {
+        // Stopped handles are never called back, which is as much as can be done without closing them; the channels and sampler stop theirs as they go.
+        logger().critical("Driver destroyed before close() completed, its handles are still linked into the loop");
+        stop();
+    }
 }
 
-static RGB hsvToRGB(double h, double s, double v)
+void Driver::stop()
 {
-    double hue = h * 360;
-    RGB rgb;
-    rgb.red = static_cast<uint8_t>(hsvf(5, hue, s, v) * 255);
-    rgb.green = static_cast<uint8_t>(hsvf(3, hue, s, v) * 255);
-    rgb.blue = static_cast<uint8_t>(hsvf(1, hue, s, v) * 255);
-    return rgb;
-}
+    // The worker drives lines owned by the channels, so it must stop before they are destroyed.
+    if (_realtime) {
+        _realtime->stop();
+    }
 
-static double temperatureToHue(double temperature, const Configuration& config)
-{
-    // Hue is expected to be the distance the temperature is from the onThreshold represented as a percentage normalized by 1/3.
-    static constexpr double NORMALIZATION_FACTOR = 0.333333;
-    if (temperature < config.offThreshold()) {
-        return NORMALIZATION_FACTOR;
+    for (const auto& channel : _channels) {
+        writeCapture(*channel);
     }
-    else if (temperature > config.onThreshold()) {
-        return 0.0;
+
+    _led_task.stop();
+    _temperature_task.stop();
+    _button_task.stop();
+    _override_task.stop();
+    _load_task.stop();
+    _throttle_task.stop();
+    _reconcile_task.stop();
+    _deferred_started = false;
+    _led_ticks = 0;
+    // A batch still in flight completes without reaching the stopped channels.
+    if (_sampler) {
+        _sampler->onComplete(nullptr);
     }
-    return ((config.onThreshold() - temperature) / (config.onThreshold() - config.offThreshold())) * NORMALIZATION_FACTOR;
+    // stop() may be called again once the driver is closed.
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t*>(&_sigint_handle))) {
+        uv_signal_stop(&_sigint_handle);
+    }
+    _control.stop();
+    _publisher.close();
 }
 
-Driver::Driver(const Configuration& configuration)
-    : _event_loop(uv_default_loop()),
-      _sigint_handle(),
-      _temp_handle(),
-      _override_handle(),
-      _button_handle(),
-      _led_handle(),
-      _config(configuration),
-      _tick_count(0),
-      _breath_values(),
-      _v((configuration.brightness() * 1.0) / MAX_BRIGHTNESS),
-      _temp_disabling_button(false),
-      _override_disabling_button(false)
+void Driver::close(CloseCallback callback)
 {
-    uv_signal_init(_event_loop, &_sigint_handle);
-    uv_timer_init(_event_loop, &_led_handle);
-    uv_timer_init(_event_loop, &_temp_handle);
-    uv_timer_init(_event_loop, &_button_handle);
-    uv_timer_init(_event_loop, &_override_handle);
-
-    auto tick_callback = std::bind(&Driver::_onTick, this, args::_1);
-    Context::instance().setTickCallback(tick_callback);
-
-    auto temp_callback = std::bind(&Driver::_onReadTemperature, this, args::_1);
-    Context::instance().setReadTemperatureCallback(temp_callback);
+    if (_closing) {
+        return;
+    }
 
-    auto override_callback = std::bind(&Driver::_onCheckOverride, this, args::_1);
-    Context::instance().setOverrideCallback(override_callback);
+    stop();
+    _closing = true;
+    _on_closed = std::move(callback);
+
+    // One extra count is held until every close has been requested, so that a component with nothing left open cannot complete the close early.
+    _closing_handles = 9;
+    _temperature_task.close(_onHandleClosed);
+    _override_task.close(_onHandleClosed);
+    _button_task.close(_onHandleClosed);
+    _led_task.close(_onHandleClosed);
+    _load_task.close(_onHandleClosed);
+    _throttle_task.close(_onHandleClosed);
+    _reconcile_task.close(_onHandleClosed);
+    uv_close(reinterpret_cast<uv_handle_t*>(&_sigint_handle), _onHandleClosed);
+
+    for (const auto& channel : _channels) {
+        _closing_handles++;
+        channel->close([this]() { _handleClosed(); });
+    }
 
-    auto button_callback = std::bind(&Driver::_onCheckButton, this, args::_1);
-    Context::instance().setButtonCallback(button_callback);
+    _closing_handles++;
+    _control.close([this]() { _handleClosed(); });
 
-    _breath_values.resize(_config.breathBrightness() * 2);
-    for (size_t i = 0; i < _config.breathBrightness() * 2; i++) {
-        if (i < _config.breathBrightness()) {
-            _breath_values[i] = i;
-        }
-        else {
-            _breath_values[i] = 2 * _config.breathBrightness() - i;
-        }
+    // The sampler's poll handle is only unlinked from the loop in its close callback, so the sampler is freed there.
+    if (_sampler) {
+        _closing_handles++;
+        _sampler->close([this]() {
+            _sampler.reset();
+            _handleClosed();
+        });
     }
-}
-
-Driver::~Driver()
-{
-    uv_timer_stop(&_led_handle);
-    uv_timer_stop(&_temp_handle);
-    uv_timer_stop(&_button_handle);
-    uv_timer_stop(&_override_handle);
-    uv_signal_stop(&_sigint_handle);
+    _handleClosed();
 }
 
 int32_t Driver::run()
 {
     uv_signal_cb signal_callback = [](uv_signal_t* handle, int32_t signal_number) {};
-    uv_timer_cb tick_callback = [](uv_timer_t* handle) { Context::instance().onTick(handle); };
-    uv_timer_cb temp_callback = [](uv_timer_t* handle) { Context::instance().onReadTemperature(handle); };
-    uv_timer_cb override_callback = [](uv_timer_t* handle) { Context::instance().onOverrideCheck(handle); };
-    uv_timer_cb button_callback = [](uv_timer_t* handle) { Context::instance().onButtonCheck(handle); };
 
     int32_t result = uv_signal_start(&_sigint_handle, signal_callback, SIGINT);
     if (result) {
         logger().error("Failed to start signal callback: {}", uv_strerror(result));
     }
 
-    result = uv_timer_start(&_temp_handle, temp_callback, 0, _config.delay().count());
+    start();
+    serve();
+
+    logger().warn("Fanshim Driver Started with {} channel(s)", _channels.size());
+
+    return uv_run(_event_loop, UV_RUN_DEFAULT);
+}
+
+void Driver::start()
+{
+    if (_realtime) {
+        _realtime->start();
+    }
+
+    if (_sampler) {
+        _sampler->onComplete([this]() { _applyTemperatures(); });
+    }
+
+    bool has_sensor = std::any_of(_channels.begin(), _channels.end(), [](const auto& channel) { return channel->hasSensor(); });
+    int32_t result = has_sensor ? _temperature_task.start(_config.delay()) : 0;
     if (result) {
         logger().error("Failed to start temperature check timer: {}", uv_strerror(result));
     }
 
-    result = uv_timer_start(&_override_handle, override_callback, 0, OVERRIDE_RATE.count());
+    result = _override_task.start(OVERRIDE_RATE);
     if (result) {
         logger().error("Failed to start override check timer: {}", uv_strerror(result));
     }
 
-    result = uv_timer_start(&_button_handle, button_callback, 0, BUTTON_RATE.count());
+    result = _button_task.start(BUTTON_RATE);
     if (result) {
         logger().error("Failed to start button check timer: {}", uv_strerror(result));
     }
 
-    if (_config.blink() == BlinkType::NO_BLINK) {
-        gpio().setBrightness(_config.brightness());
+    startupTimeline().mark(StartupPhase::TIMERS);
+}
+
+void Driver::serve()
+{
+    _control.start(_config.controlSocket());
+    _publisher.open(_config.statusSegment());
+    startupTimeline().mark(StartupPhase::SERVE);
+}
+
+bool Driver::feedTemperature(std::string_view name, double temperature)
+{
+    Channel* target = channel(name);
+    if (!target) {
+        return false;
     }
-    else {
-        logger().debug("Enabling LED type {}", static_cast<uint8_t>(_config.blink()));
-        result = uv_timer_start(&_led_handle, tick_callback, 0, LED_RATE.count());
-        if (result) {
-            logger().error("Failed to start LED timer: {}", uv_strerror(result));
+
+    ScopedTimer timer(_stats.temperature);
+    target->feedTemperature(temperature);
+    if (!_deferred_started) {
+        _startDeferred();
+    }
+    _metrics.write(_channels, _throttle);
+    publishStatus();
+    return true;
+}
+
+const std::vector<std::unique_ptr<Channel>>& Driver::channels() const
+{
+    return _channels;
+}
+
+Channel* Driver::channel(std::string_view name) const
+{
+    for (const auto& channel : _channels) {
+        if (channel->name() == name) {
+            return channel.get();
         }
     }
+    return nullptr;
+}
 
-    logger().warn("Fanshim Driver Started");
+const DriverStats& Driver::stats() const
+{
+    return _stats;
+}
 
-    return uv_run(_event_loop, UV_RUN_DEFAULT);
+const LoadMonitor& Driver::load() const
+{
+    return _load;
 }
 
-void Driver::_blinkLED()
+const ThrottleMonitor& Driver::throttle() const
 {
-    if (gpio().getFan()) {
-        return;
+    return _throttle;
+}
+
+const RealtimeWorker* Driver::realtime() const
+{
+    return _realtime.get();
+}
+
+const AttributeSampler* Driver::sampler() const
+{
+    return _sampler.get();
+}
+
+const CaptureBackend* Driver::capture(const Channel& channel) const
+{
+    for (size_t i = 0; i < _channels.size(); ++i) {
+        if (_channels[i].get() == &channel) {
+            return _captures[i];
+        }
     }
+    return nullptr;
+}
 
-    _tick_count++;
-    if (_tick_count % 10 == 0) {
-        gpio().setBrightness(OFF);
+bool Driver::writeCapture(const Channel& channel) const
+{
+    const CaptureBackend* capture = this->capture(channel);
+    if (!capture) {
+        return false;
     }
-    else if (_tick_count % 5 == 0) {
-        gpio().setBrightness(_config.brightness());
+
+    std::filesystem::path path = _config.captureDirectory() / (channel.name() + ".vcd");
+    if (!capture->writeVCD(path, channel.name())) {
+        return false;
     }
+
+    logger().info("Wrote {} transition(s) of channel {} to {} [Dropped: {}]", capture->size(), channel.name(), path.native(), capture->dropped());
+    return true;
 }
 
-void Driver::_breatheLED()
+void Driver::publishStatus()
 {
-    gpio().setBrightness(_breath_values[_tick_count % _breath_values.size()]);
-    _tick_count++;
+    StatusSnapshot snapshot = {};
+    snapshot.timestamp_ns = _clock.hrtime();
+    snapshot.updates = ++_stats.status_updates;
+    snapshot.channel_count = static_cast<uint32_t>(_channels.size());
+
+    for (size_t i = 0; i < _channels.size(); ++i) {
+        const Channel& channel = *_channels[i];
+        StatusChannel& status = snapshot.channels[i];
+        channel.name().copy(status.name, STATUS_NAME_SIZE - 1);
+        status.temperature = channel.temperature();
+        status.temperature_reads = channel.stats().temperature_reads;
+        status.fan_transitions = channel.stats().fan_transitions;
+        status.fan = channel.fan();
+        status.button = channel.button();
+        status.override_active = channel.overrideActive();
+        status.temperature_active = channel.temperatureActive();
+        status.force = static_cast<uint8_t>(channel.forceState());
+    }
+    _publisher.publish(snapshot);
 }
 
-void Driver::_onCheckButton(uv_timer_t* /* unused */)
+void Driver::checkButtons()
 {
-    if (_override_disabling_button || _temp_disabling_button) {
-        logger().debug("Driver is skipping the button check due to state [Override: {}, Temperature: {}]", _override_disabling_button, _temp_disabling_button);
+    ScopedTimer timer(_stats.button);
+    for (auto& channel : _channels) {
+        channel->checkButton();
+    }
+    publishStatus();
+}
+
+void Driver::checkLoad()
+{
+    ScopedTimer timer(_stats.load);
+    if (!_load.sample(std::chrono::milliseconds(_clock.now()))) {
         return;
     }
 
-    if (gpio().getButton()) {
-        gpio().setFan(true);
+    logger().warn("Load is {} [Utilisation: {:.1f}%, Load Average: {:.2f}]", _load.high() ? "high" : "normal", _load.utilisation(), _load.loadAverage());
+    double bias = _load.high() ? _config.loadBias() : 0.0;
+    for (auto& channel : _channels) {
+        channel->setLoadBias(bias);
+    }
+    publishStatus();
+}
+
+void Driver::checkThrottle()
+{
+    ScopedTimer timer(_stats.throttle);
+
+    bool near_trip_point = false;
+    for (const auto& channel : _channels) {
+        near_trip_point = near_trip_point || channel->nearTripPoint();
+    }
+
+    if (!_throttle.sample(std::chrono::milliseconds(_clock.now()), near_trip_point)) {
+        return;
     }
-    else if (gpio().getFan()) {
-        gpio().setFan(false);
+
+    logger().warn("CPU {} [Frequency: {:.0f}% of maximum]", _throttle.throttled() ? "throttled" : "no longer throttled", _throttle.frequencyRatio() * 100);
+    if (_config.throttleFan()) {
+        for (auto& channel : _channels) {
+            channel->setThrottleHold(_throttle.throttled());
+        }
     }
+    publishStatus();
 }
 
-void Driver::_onCheckOverride(uv_timer_t* /* unused */)
+void Driver::checkOverride()
 {
+    ScopedTimer timer(_stats.override_check);
     std::error_code ec;
-    if (gpio().getFan()) {
-        logger().debug("Fan already running, skipping override");
-        return;
+
+    bool override_requested = std::filesystem::exists(_config.forceFile(), ec);
+    for (auto& channel : _channels) {
+        channel->checkOverride(override_requested);
     }
+    publishStatus();
+}
 
-    if (!std::filesystem::exists(_config.forceFile(), ec)) {
-        _override_disabling_button = false;
+void Driver::readTemperatures()
+{
+    if (_sampler) {
+        // The channels see the new temperatures once the batch completes on the loop; a tick that finds the last batch still in flight is skipped.
+        _sampler->submit();
         return;
     }
+    _applyTemperatures();
+}
+
+void Driver::reconcileLines()
+{
+    ScopedTimer timer(_stats.reconcile);
+    for (auto& channel : _channels) {
+        channel->reconcileLines();
+    }
+}
+
+void Driver::tickLED()
+{
+    ScopedTimer timer(_stats.led);
+
+    // Each channel reports how many LED periods remain until its output changes; the timer sleeps until the soonest of them, and stops while none will.
+    uint32_t elapsed = std::max<uint32_t>(_led_ticks, 1);
+    uint32_t next = 0;
+    for (auto& channel : _channels) {
+        uint32_t ticks = 0;
+        switch (_config.blink()) {
+        case BlinkType::BLINK:
+            ticks = channel->blinkLED(elapsed);
+            break;
+        case BlinkType::BREATHE:
+            ticks = channel->breatheLED(_breath_values, elapsed);
+            break;
+        case BlinkType::NO_BLINK:
+        default:
+            break;
+        }
+
+        if (ticks > 0 && (next == 0 || ticks < next)) {
+            next = ticks;
+        }
+    }
 
-    logger().warn("Override file exists, enabling fan");
-    _override_disabling_button = true;
-    gpio().setFan(true);
+    _scheduleLED(next);
 }
 
-void Driver::_onReadTemperature(uv_timer_t* /* unused */)
+void Driver::_startDeferred()
 {
-    double current_temperature = getCPUTemperature();
+    // Nothing here decides a fan, so it waits for the first temperature to have done so.
+    _deferred_started = true;
+
+    StartupTimeline& startup = startupTimeline();
+    if (!startup.reached(StartupPhase::FIRST_CONTROL)) {
+        startup.mark(StartupPhase::FIRST_CONTROL);
+        logger().warn("First control action {:.1f} ms after startup [Logger: {:.1f} ms, Configuration: {:.1f} ms, Driver: {:.1f} ms, Timers: {:.1f} ms, Serve: {:.1f} ms, First Control: {:.1f} ms]",
+                      startup.elapsedNs(StartupPhase::FIRST_CONTROL) / 1e6,
+                      startup.durationNs(StartupPhase::LOGGER) / 1e6,
+                      startup.durationNs(StartupPhase::CONFIGURATION) / 1e6,
+                      startup.durationNs(StartupPhase::DRIVER) / 1e6,
+                      startup.durationNs(StartupPhase::TIMERS) / 1e6,
+                      startup.durationNs(StartupPhase::SERVE) / 1e6,
+                      startup.durationNs(StartupPhase::FIRST_CONTROL) / 1e6);
+    }
+
+    _breath_values.resize(_config.breathBrightness() * 2);
+    for (size_t i = 0; i < _config.breathBrightness() * 2; i++) {
+        if (i < _config.breathBrightness()) {
+            _breath_values[i] = i;
+        }
+        else {
+            _breath_values[i] = 2 * _config.breathBrightness() - i;
+        }
+    }
 
-    if (current_temperature >= _config.onThreshold()) {
-        _temp_disabling_button = true;
-        gpio().setFan(true);
+    int32_t result = 0;
+    if (_config.blink() == BlinkType::NO_BLINK) {
+        for (auto& channel : _channels) {
+            channel->setBrightness(_config.brightness());
+        }
+    }
+    else {
+        logger().debug("Enabling LED type {}", static_cast<uint8_t>(_config.blink()));
+        _scheduleLED(1);
     }
-    else if (current_temperature < _config.offThreshold()) {
-        _temp_disabling_button = false;
-        gpio().setFan(false);
+
+    if (_config.loadThreshold() > 0 && _load.open()) {
+        result = _load_task.start(LOAD_RATE, LOAD_RATE);
+        if (result) {
+            logger().error("Failed to start load check timer: {}", uv_strerror(result));
+        }
+    }
+
+    if (_throttle.open()) {
+        result = _throttle_task.start(THROTTLE_RATE);
+        if (result) {
+            logger().error("Failed to start throttle check timer: {}", uv_strerror(result));
+        }
     }
 
-    std::ofstream prom_stream(_config.outputFile());
-    if (prom_stream.good()) {
-        prom_stream << FAN_HEADER << std::to_string(gpio().getFan()) << std::endl;
-        prom_stream << TEMP_HEADER << std::to_string(static_cast<int32_t>(current_temperature)) << std::endl;
-        prom_stream.close();
+    if (_config.reconcileInterval().count() > 0) {
+        if (_realtime) {
+            logger().warn("GPIO line reconciliation is disabled while the realtime worker drives the lines");
+        }
+        else {
+            result = _reconcile_task.start(_config.reconcileInterval(), _config.reconcileInterval());
+            if (result) {
+                logger().error("Failed to start GPIO reconcile timer: {}", uv_strerror(result));
+            }
+        }
     }
+}
 
-    RGB ledColor = hsvToRGB(temperatureToHue(current_temperature, _config), S, _v);
-    gpio().setLED(ledColor);
+void Driver::_applyTemperatures()
+{
+    ScopedTimer timer(_stats.temperature);
+    for (auto& channel : _channels) {
+        channel->readTemperature();
+    }
+    if (!_deferred_started) {
+        _startDeferred();
+    }
 
-    logger().info("New CPU Temperature: {}, Fan State: {}, LED Color: [0x{:02X}{:02X}{:02X}]", current_temperature, gpio().getFan(), ledColor.red, ledColor.blue, ledColor.green);
+    _metrics.write(_channels, _throttle);
+    publishStatus();
+}
+
+void Driver::_scheduleLED(uint32_t ticks)
+{
+    if (ticks == _led_ticks) {
+        return;
+    }
+
+    _led_ticks = ticks;
+    if (ticks == 0) {
+        logger().debug("LED output is static, suspending the LED timer");
+        _led_task.stop();
+        return;
+    }
+
+    int32_t result = _led_task.start(LED_RATE * ticks, LED_RATE * ticks);
+    if (result) {
+        logger().error("Failed to start LED timer: {}", uv_strerror(result));
+        _led_ticks = 0;
+    }
+}
+
+void Driver::_wakeLED()
+{
+    // A fan transition starts or stops blinking, so the LEDs are checked again on the next period, once they have been started.
+    if (_deferred_started && _config.blink() != BlinkType::NO_BLINK) {
+        _scheduleLED(1);
+    }
 }
 
 void Driver::_onSignal(uv_signal_t* /* unused */, int32_t signal)
 {
-    // Set GPIO to default state
-    gpio().setFan(false);
-    gpio().setBrightness(OFF);
+    for (auto& channel : _channels) {
+        channel->shutdown();
+    }
 }
 
-void Driver::_onTick(uv_timer_t* /* unused */)
+
+void Driver::_handleClosed()
 {
-    switch (_config.blink()) {
-    case BlinkType::BLINK:
-        _blinkLED();
-    case BlinkType::BREATHE:
-        _breatheLED();
-    case BlinkType::NO_BLINK:
-    default:
-        break;
+    if (--_closing_handles > 0) {
+        return;
     }
+
+    _closed = true;
+    if (_on_closed) {
+        _on_closed();
+    }
+}
+
+void Driver::_onHandleClosed(uv_handle_t* handle)
+{
+    static_cast<Driver*>(handle->data)->_handleClosed();
 }
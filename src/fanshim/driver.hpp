@@ -1,46 +1,169 @@
 #pragma once
 
+#include "fanshim/backend.hpp"
+#include "fanshim/capture.hpp"
+#include "fanshim/channel.hpp"
+#include "fanshim/clock.hpp"
 #include "fanshim/configuration.hpp"
+#include "fanshim/control.hpp"
+#include "fanshim/load.hpp"
+#include "fanshim/metrics.hpp"
+#include "fanshim/periodic_task.hpp"
+#include "fanshim/publisher.hpp"
+#include "fanshim/realtime.hpp"
+#include "fanshim/sampler.hpp"
+#include "fanshim/sensor.hpp"
+#include "fanshim/stats.hpp"
+#include "fanshim/throttle.hpp"
 
 #include <uv.h>
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 
+struct DriverStats
+{
+    TimerStats temperature;
+    TimerStats override_check;
+    TimerStats button;
+    TimerStats led;
+    TimerStats load;
+    TimerStats throttle;
+    TimerStats reconcile;
+    uint64_t status_updates;
+};
+
 class Driver
 {
 public:
-    Driver(const Configuration& configuration);
+    using CloseCallback = std::function<void()>;
+
+    /**
+     * Creates a driver whose timers run on `loop` in real time, or against `clock` if one is given.
+     */
+    Driver(const Configuration& configuration,
+           uv_loop_t* loop = uv_default_loop(),
+           GPIOBackend::Factory backend_factory = GpiodBackend::create,
+           Clock* clock = nullptr,
+           TemperatureSource::Factory sensor_factory = FileTemperatureSource::create);
     ~Driver();
 
     int32_t run();
 
+    /**
+     * Arms the periodic timers without starting the control socket, the status segment or the event loop. The temperature timer is only armed if a channel
+     * has a sensor to read. The LED, load, throttle and reconcile timers are armed once the first temperature has decided the fans.
+     */
+    void start();
+
+    /**
+     * Opens the control socket and the status segment named in the configuration.
+     */
+    void serve();
+
+    /**
+     * Stops every timer, the realtime worker, the control socket and the status segment, leaving the fans as they are.
+     */
+    void stop();
+
+    /**
+     * Stops the driver and closes the handles it owns on the loop: its timers and signal handle, the channels' timers, the control socket and its clients, and
+     * the sampler's poll handle. `callback` is called once the loop has closed all of them. The driver must be closed, and the loop run until then, before it
+     * is destroyed, and is not used again in between.
+     */
+    void close(CloseCallback callback);
+
+    /**
+     * Hands `channel` a temperature read outside the driver. Returns false if there is no such channel.
+     */
+    bool feedTemperature(std::string_view channel, double temperature);
+
+    void checkButtons();
+    void checkLoad();
+    void checkThrottle();
+    void checkOverride();
+    void readTemperatures();
+    void reconcileLines();
+    void tickLED();
+
+    const std::vector<std::unique_ptr<Channel>>& channels() const;
+    Channel* channel(std::string_view name) const;
+    const DriverStats& stats() const;
+    const LoadMonitor& load() const;
+    const ThrottleMonitor& throttle() const;
+    const RealtimeWorker* realtime() const;
+
+    /**
+     * The batched sensor sampler, or nullptr if every channel reads its own sensor.
+     */
+    const AttributeSampler* sampler() const;
+
+    /**
+     * The channel's line capture, or nullptr if capture is disabled.
+     */
+    const CaptureBackend* capture(const Channel& channel) const;
+
+    /**
+     * Writes the channel's line capture to `<capture-dir>/<channel>.vcd`.
+     */
+    bool writeCapture(const Channel& channel) const;
+
+    void publishStatus();
+
 private:
     Driver(const Driver&) = delete;
     Driver(Driver&&) = delete;
     Driver& operator=(const Driver&) = delete;
     Driver& operator=(Driver&&) = delete;
 
-    void _blinkLED();
-    void _breatheLED();
-
-    void _onCheckButton(uv_timer_t* handle);
-    void _onCheckOverride(uv_timer_t* handle);
-    void _onReadTemperature(uv_timer_t* handle);
     void _onSignal(uv_signal_t* handle, int32_t signal);
-    void _onTick(uv_timer_t* handle);
+    void _handleClosed();
+
+    static void _onHandleClosed(uv_handle_t* handle);
+
+    /**
+     * Runs the LED timer every `ticks` LED periods, or stops it while `ticks` is 0.
+     */
+    void _scheduleLED(uint32_t ticks);
+    void _wakeLED();
+    void _startDeferred();
+
+    /**
+     * Hands every channel its temperature, once the sensors have been read.
+     */
+    void _applyTemperatures();
 
     uv_loop_t* _event_loop;
+    LoopClock _loop_clock;
+    Clock& _clock;
     uv_signal_t _sigint_handle;
-    uv_timer_t _temp_handle;
-    uv_timer_t _override_handle;
-    uv_timer_t _button_handle;
-    uv_timer_t _led_handle;
+    PeriodicTask<Driver, &Driver::readTemperatures> _temperature_task;
+    PeriodicTask<Driver, &Driver::checkOverride> _override_task;
+    PeriodicTask<Driver, &Driver::checkButtons> _button_task;
+    PeriodicTask<Driver, &Driver::tickLED> _led_task;
+    PeriodicTask<Driver, &Driver::checkLoad> _load_task;
+    PeriodicTask<Driver, &Driver::checkThrottle> _throttle_task;
+    PeriodicTask<Driver, &Driver::reconcileLines> _reconcile_task;
     Configuration _config;
-    uint8_t _tick_count;
+    ControlServer _control;
+    StatusPublisher _publisher;
+    MetricsFile _metrics;
+    LoadMonitor _load;
+    ThrottleMonitor _throttle;
+    DriverStats _stats;
+    std::unique_ptr<RealtimeWorker> _realtime;
+    std::unique_ptr<AttributeSampler> _sampler;
+    std::vector<std::unique_ptr<Channel>> _channels;
+    std::vector<CaptureBackend*> _captures;
     std::vector<uint8_t> _breath_values;
-    double _v;
-    bool _temp_disabling_button;
-    bool _override_disabling_button;
+    CloseCallback _on_closed;
+    uint32_t _closing_handles;
+    uint32_t _led_ticks;
+    bool _deferred_started;
+    bool _closing;
+    bool _closed;
 };
@@ -0,0 +1,83 @@
+#include "fanshim/filter.hpp"
+
+#include "fanshim/sensor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+TemperatureFilter::TemperatureFilter(const SensorFilter& configuration)
+    : _config(configuration),
+      _window(),
+      _window_size(0),
+      _next(0),
+      _last_accepted(NO_TEMPERATURE),
+      _value(NO_TEMPERATURE),
+      _rejected(0),
+      _stats()
+{
+    _config.median_window = std::clamp<uint8_t>(_config.median_window, 1, MAX_MEDIAN_WINDOW);
+    _config.smoothing = std::min(_config.smoothing, MAX_SMOOTHING);
+    // The configuration file requires at least one; a filter built in code with none still rejects a single spike rather than none at all.
+    _config.max_rejections = std::max<uint8_t>(_config.max_rejections, 1);
+}
+
+double TemperatureFilter::apply(double raw)
+{
+    if (std::isnan(raw)) {
+        _stats.failures++;
+        return _value;
+    }
+
+    if (_config.max_step > 0.0 && !std::isnan(_last_accepted) && std::fabs(raw - _last_accepted) > _config.max_step) {
+        if (++_rejected <= _config.max_rejections) {
+            _stats.rejections++;
+            return _value;
+        }
+
+        // The samples agree that the temperature has moved; start the window afresh so that older samples do not hold the median back.
+        _window_size = 0;
+        _next = 0;
+    }
+
+    _rejected = 0;
+    _last_accepted = raw;
+
+    double median = _median(raw);
+    if (std::isnan(_value) || _config.smoothing == 0) {
+        _value = median;
+    }
+    else {
+        _value = (_config.smoothing * _value + (100 - _config.smoothing) * median) / 100.0;
+    }
+    return _value;
+}
+
+double TemperatureFilter::value() const
+{
+    return _value;
+}
+
+const FilterStats& TemperatureFilter::stats() const
+{
+    return _stats;
+}
+
+double TemperatureFilter::_median(double sample)
+{
+    if (_config.median_window == 1) {
+        return sample;
+    }
+
+    _window[_next] = sample;
+    _next = (_next + 1) % _config.median_window;
+    _window_size = std::min<size_t>(_window_size + 1, _config.median_window);
+
+    std::array<double, MAX_MEDIAN_WINDOW> sorted = _window;
+    auto middle = sorted.begin() + _window_size / 2;
+    std::nth_element(sorted.begin(), middle, sorted.begin() + _window_size);
+    return *middle;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "fanshim/configuration.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+struct FilterStats
+{
+    uint64_t failures;
+    uint64_t rejections;
+};
+
+/**
+ * Filters one sensor's samples before a channel acts on them, in constant memory and time per sample:
+ *
+ *  1. A failed read is not a temperature; the last filtered value is held instead.
+ *  2. A sample further than `max_step` degrees from the last accepted sample is rejected as a spike and the last value held. Once `max_rejections`
+ *     samples in a row have been rejected, the temperature has really moved and the next sample at the new level is accepted.
+ *  3. The median of the last `median_window` accepted samples removes what spikes are left.
+ *  4. An EWMA, giving the previous value `smoothing` percent of the weight, smooths the median.
+ */
+class TemperatureFilter
+{
+public:
+    TemperatureFilter(const SensorFilter& configuration);
+
+    /**
+     * Feeds a raw sample, NO_TEMPERATURE for a failed read, and returns the filtered temperature. Returns NO_TEMPERATURE until a sample is accepted.
+     */
+    double apply(double raw);
+
+    double value() const;
+    const FilterStats& stats() const;
+
+private:
+    double _median(double sample);
+
+    SensorFilter _config;
+    std::array<double, MAX_MEDIAN_WINDOW> _window;
+    size_t _window_size;
+    size_t _next;
+    double _last_accepted;
+    double _value;
+    uint32_t _rejected;
+    FilterStats _stats;
+};
@@ -1,61 +1,110 @@
 #include "fanshim/gpio.hpp"
 
 #include "fanshim/logger.hpp"
+#include "fanshim/realtime.hpp"
 
-#include <gpiod.hpp>
-
-#include <chrono>
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
-#include <string_view>
-#include <thread>
+#include <memory>
+#include <utility>
+#include <vector>
 
 
-inline constexpr int32_t CLK_PIN = 14;
-inline constexpr int32_t DATA_PIN = 15;
-inline constexpr int32_t FAN_PIN = 18;
-inline constexpr int32_t BUTTON_PIN = 17;
-inline constexpr std::string_view CHIP_NAME = "gpiochip0";
-inline constexpr std::string_view CONSUMER_NAME = "fanshim";
-inline constexpr std::chrono::microseconds CLOCK_STRETCH = std::chrono::microseconds(5);
-inline constexpr size_t NUM_LEDS = 1;
+inline constexpr size_t APA102_WORD_SIZE = 4;
+inline constexpr uint8_t APA102_LED_HEADER = 0xE0;
+inline constexpr uint8_t APA102_END_BYTE = 0xFF;
 
 
-GPIOInterface::GPIOInterface() : _chip(CHIP_NAME.data(), gpiod::chip::OPEN_BY_NAME), _button(), _fan(), _led_clk(), _led_data(), _rgb(), _brightness(OFF)
+APA102Chain::APA102Chain(size_t led_count) : _pixels(std::max<size_t>(led_count, 1)), _frame(), _bits(0)
 {
-    gpiod::line_request write_request;
-    write_request.consumer = CONSUMER_NAME;
-    write_request.request_type = gpiod::line_request::DIRECTION_OUTPUT;
-    write_request.flags = 0;
+    // The start frame is 32 zero bits. The end frame is at least n/2 one bits, where n is the number of LEDs in the chain, so that the data has been
+    // clocked through to the last LED; it is padded to a whole byte here, but only `_bits` are shifted out.
+    size_t end_bits = (_pixels.size() + 1) / 2;
+    _bits = APA102_WORD_SIZE * __CHAR_BIT__ * (1 + _pixels.size()) + end_bits;
+    _frame.assign(APA102_WORD_SIZE * (1 + _pixels.size()), 0);
+    _frame.resize(_frame.size() + (end_bits + __CHAR_BIT__ - 1) / __CHAR_BIT__, APA102_END_BYTE);
+}
 
-    gpiod::line_request read_request;
-    read_request.consumer = CONSUMER_NAME;
-    read_request.request_type = gpiod::line_request::DIRECTION_INPUT;
-    read_request.flags = 0;
+size_t APA102Chain::size() const
+{
+    return _pixels.size();
+}
 
-    _button = _chip.get_line(BUTTON_PIN);
-    _button.request(read_request);
+const RGB& APA102Chain::pixel(size_t index) const
+{
+    return _pixels[index];
+}
 
-    _fan = _chip.get_line(FAN_PIN);
-    _fan.request(write_request, 0);
+void APA102Chain::setPixel(size_t index, const RGB& rgb)
+{
+    if (index < _pixels.size()) {
+        _pixels[index] = rgb;
+    }
+}
 
-    _led_clk = _chip.get_line(DATA_PIN);
-    _led_clk.request(write_request, 0);
+void APA102Chain::fill(const RGB& rgb)
+{
+    std::fill(_pixels.begin(), _pixels.end(), rgb);
+}
+
+size_t APA102Chain::encode(uint8_t brightness)
+{
+    // Each LED is a 32 bit word: [<0xE0+brightness> <blue> <green> <red>]. The start and end frames never change.
+    uint8_t header = APA102_LED_HEADER | std::min(brightness, MAX_BRIGHTNESS);
+    uint8_t* out = _frame.data() + APA102_WORD_SIZE;
+    for (const RGB& rgb : _pixels) {
+        out[0] = header;
+        out[1] = rgb.blue;
+        out[2] = rgb.green;
+        out[3] = rgb.red;
+        out += APA102_WORD_SIZE;
+    }
+    return _bits;
+}
 
-    _led_data = _chip.get_line(CLK_PIN);
-    _led_data.request(write_request, 0);
+const std::vector<uint8_t>& APA102Chain::frame() const
+{
+    return _frame;
+}
+
+void APA102Chain::show(GPIOBackend& backend, uint8_t brightness)
+{
+    backend.shiftOut(_frame.data(), encode(brightness));
+}
 
+GPIOInterface::GPIOInterface(const ChannelConfiguration& configuration, std::unique_ptr<GPIOBackend> backend, RealtimeWorker* realtime)
+    : _backend(configuration, std::move(backend)),
+      _realtime(realtime),
+      _chain(configuration.led_count),
+      _rgb(),
+      _brightness(OFF),
+      _duty(0),
+      _slot(0),
+      _has_button(configuration.button_pin != NO_PIN),
+      _has_led(configuration.clock_pin != NO_PIN && configuration.data_pin != NO_PIN)
+{
     // Previous implementations seem to default to a blueish color, presumably so that if brightness is modified first a color is actually present.
     _rgb.red = 0;
     _rgb.green = 0;
     _rgb.blue = 190;
+    _chain.fill(_rgb);
+
+    if (_realtime) {
+        _slot = _realtime->attach(_backend, _chain.size());
+    }
+}
+
+GPIOInterface::~GPIOInterface() = default;
+
+bool GPIOInterface::hasButton() const
+{
+    return _has_button;
 }
 
-GPIOInterface::~GPIOInterface()
+bool GPIOInterface::hasLED() const
 {
-    _button.release();
-    _fan.release();
-    _led_clk.release();
-    _led_data.release();
+    return _has_led;
 }
 
 uint8_t GPIOInterface::getBrightness() const
@@ -65,12 +114,38 @@ uint8_t GPIOInterface::getBrightness() const
 
 bool GPIOInterface::getButton() const
 {
-    return _button.get_value() == HIGH;
+    return _has_button && _backend.read(Line::BUTTON) == HIGH;
 }
 
 bool GPIOInterface::getFan() const
 {
-    return _fan.get_value() == HIGH;
+    // The worker may be partway through a PWM period, so the line only reflects the requested state when the event loop drives it.
+    if (_realtime) {
+        return _duty > 0;
+    }
+    return _backend.read(Line::FAN) == HIGH;
+}
+
+uint8_t GPIOInterface::getFanDuty() const
+{
+    if (_realtime) {
+        return _duty;
+    }
+    return getFan() ? MAX_DUTY : 0;
+}
+
+const ShadowStats& GPIOInterface::shadowStats() const
+{
+    return _backend.stats();
+}
+
+uint32_t GPIOInterface::reconcile()
+{
+    // The worker thread writes the lines at any time, so they can only be compared with the shadow when the event loop drives them.
+    if (_realtime) {
+        return 0;
+    }
+    return _backend.reconcile();
 }
 
 const RGB& GPIOInterface::getRGB() const
@@ -78,6 +153,16 @@ const RGB& GPIOInterface::getRGB() const
     return _rgb;
 }
 
+size_t GPIOInterface::getLEDCount() const
+{
+    return _chain.size();
+}
+
+const RGB& GPIOInterface::getPixel(size_t index) const
+{
+    return _chain.pixel(index);
+}
+
 void GPIOInterface::setBrightness(uint8_t brightness)
 {
     if (brightness > MAX_BRIGHTNESS) {
@@ -91,90 +176,65 @@ void GPIOInterface::setBrightness(uint8_t brightness)
 
 void GPIOInterface::setFan(bool desired)
 {
-    if (getFan() == desired) {
+    setFanDuty(desired ? MAX_DUTY : 0);
+}
+
+void GPIOInterface::setFanDuty(uint8_t duty)
+{
+    duty = std::min(duty, MAX_DUTY);
+    if (!_realtime && duty > 0) {
+        duty = MAX_DUTY;
+    }
+
+    if (getFanDuty() == duty) {
         logger().debug("Fan already in desired stated");
         return;
     }
 
-    if (desired) {
+    if (duty == MAX_DUTY) {
         logger().warn("Turning on fan");
-        _fan.set_value(HIGH);
+    }
+    else if (duty > 0) {
+        logger().warn("Turning on fan at {}%", duty);
     }
     else {
         logger().warn("Turning off fan");
-        _fan.set_value(LOW);
     }
+
+    if (_realtime) {
+        _duty = duty;
+        _realtime->setDuty(_slot, duty);
+        return;
+    }
+    _backend.write(Line::FAN, duty > 0 ? HIGH : LOW);
 }
 
 void GPIOInterface::setLED(const RGB& rgb)
 {
     _rgb = rgb;
+    _chain.fill(rgb);
     _refreshLED();
 }
 
-void GPIOInterface::_endFrame()
+void GPIOInterface::setPixel(size_t index, const RGB& rgb)
 {
-    // An end frame consisting of at least (n/2) bits of 1, where n is the number of LEDs in the string
-    // Since this code only controls 1 LED, 1 bits of 1 is all that is necessary.
-    for (size_t i = 0; i < NUM_LEDS; ++i) {
-        _writeBitToLED(HIGH);
-    }
+    _chain.setPixel(index, rgb);
 }
 
-void GPIOInterface::_refreshLED()
+void GPIOInterface::showLED()
 {
-    // Modifying the state of the LED requires writing an entire frame of data.
-    // A 32 bit frame for LED data is: [<0xE0+brightness> <blue> <green> <red>]
-    // There will also be a start/end value written to notify the driver that values are available.
-
-    _startFrame();
-
-    _writeByteToLED(0xE0 | _brightness);
-    _writeByteToLED(_rgb.blue);
-    _writeByteToLED(_rgb.green);
-    _writeByteToLED(_rgb.red);
-
-    _endFrame();
+    _refreshLED();
 }
 
-void GPIOInterface::_startFrame()
+void GPIOInterface::_refreshLED()
 {
-    // Before the LED is modified, a start frame must be written to setup the LED data to come.
-    // A start frame is defined as 32 zero bits (<0x00> <0x00> <0x00> <0x00>)
-    for (size_t i = 0; i < 32; ++i) {
-        _writeBitToLED(LOW);
+    if (!_has_led) {
+        return;
     }
-}
 
-void GPIOInterface::_writeBitToLED(uint8_t value)
-{
-    _led_data.set_value(value);
-    _led_clk.set_value(HIGH);
-    std::this_thread::sleep_for(CLOCK_STRETCH);
-    _led_clk.set_value(LOW);
-    std::this_thread::sleep_for(CLOCK_STRETCH);
-}
-
-void GPIOInterface::_writeByteToLED(uint8_t value)
-{
-    logger().debug("Writing {} to LED pin", value);
-    for (uint8_t n = 0; n < __CHAR_BIT__; n++) {
-        _writeBitToLED(value & (0x01 << (7 - n)));
+    if (_realtime) {
+        _realtime->writeFrame(_slot, _brightness, _chain);
+        return;
     }
+    _chain.show(_backend, _brightness);
 }
-
-GPIOContext& GPIOContext::instance()
-{
-    static GPIOContext instance;
-    return instance;
-}
-
-GPIOInterface& GPIOContext::gpio()
-{
-    return _gpio;
-}
-
-GPIOContext::GPIOContext() : _gpio()
-{}
-
-GPIOContext::~GPIOContext() = default;
@@ -1,8 +1,12 @@
 #pragma once
 
-#include <gpiod.hpp>
+#include "fanshim/backend.hpp"
+#include "fanshim/configuration.hpp"
 
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 
 inline constexpr uint8_t LOW = 0;
@@ -17,52 +21,98 @@ struct RGB
     uint8_t blue;
 };
 
+class RealtimeWorker;
+
+/**
+ * The pixels of a chain of APA102 LEDs, and the frame that shows them.
+ *
+ * The frame (a 32 bit start frame, 32 bits per LED and an end frame of at least n/2 one bits) is allocated once; show() rewrites only the LED words, in a
+ * single pass, and shifts the whole frame out with one call to the backend.
+ */
+class APA102Chain
+{
+public:
+    APA102Chain(size_t led_count = 1);
+
+    size_t size() const;
+    const RGB& pixel(size_t index) const;
+    void setPixel(size_t index, const RGB& rgb);
+    void fill(const RGB& rgb);
+
+    /**
+     * Encodes the pixels at `brightness` and returns the number of bits in the frame.
+     */
+    size_t encode(uint8_t brightness);
+    const std::vector<uint8_t>& frame() const;
+
+    void show(GPIOBackend& backend, uint8_t brightness);
+
+private:
+    std::vector<RGB> _pixels;
+    std::vector<uint8_t> _frame;
+    size_t _bits;
+};
+
 class GPIOInterface
 {
 public:
-    GPIOInterface();
+    /**
+     * Drives the channel's lines through `backend`, or hands the fan and LED outputs to `realtime` if given. The button is always read directly.
+     */
+    GPIOInterface(const ChannelConfiguration& configuration, std::unique_ptr<GPIOBackend> backend, RealtimeWorker* realtime = nullptr);
     ~GPIOInterface();
 
+    bool hasButton() const;
+    bool hasLED() const;
+
     uint8_t getBrightness() const;
     bool getButton() const;
     bool getFan() const;
     const RGB& getRGB() const;
+    size_t getLEDCount() const;
+    const RGB& getPixel(size_t index) const;
+    uint8_t getFanDuty() const;
+    const ShadowStats& shadowStats() const;
 
     void setBrightness(uint8_t brightness);
     void setFan(bool desired);
-    void setLED(const RGB& rgb);
 
-private:
-    void _endFrame();
-    void _refreshLED();
-    void _startFrame();
-    void _writeBitToLED(uint8_t value);
-    void _writeByteToLED(uint8_t value);
-
-    gpiod::chip _chip;
-    gpiod::line _button;
-    gpiod::line _fan;
-    gpiod::line _led_clk;
-    gpiod::line _led_data;
-    RGB _rgb;
-    uint8_t _brightness;
-};
+    /**
+     * Runs the fan at `duty` percent. Without a realtime worker the fan cannot be pulsed, so any non-zero duty turns it fully on.
+     */
+    void setFanDuty(uint8_t duty);
 
-class GPIOContext
-{
-public:
-    static GPIOContext& instance();
+    /**
+     * Sets every LED in the chain to `rgb` and shows it.
+     */
+    void setLED(const RGB& rgb);
+
+    /**
+     * Changes one LED of the chain; nothing is shown until showLED().
+     */
+    void setPixel(size_t index, const RGB& rgb);
+    void showLED();
 
-    GPIOInterface& gpio();
+    /**
+     * Reads the output lines back from the chip and adopts any value changed outside the driver. Returns the number of lines that had changed.
+     */
+    uint32_t reconcile();
 
 private:
-    GPIOContext();
-    ~GPIOContext();
+    GPIOInterface(const GPIOInterface&) = delete;
+    GPIOInterface(GPIOInterface&&) = delete;
+    GPIOInterface& operator=(const GPIOInterface&) = delete;
+    GPIOInterface& operator=(GPIOInterface&&) = delete;
 
-    GPIOInterface _gpio;
-};
+    void _refreshLED();
 
-inline GPIOInterface& gpio()
-{
-    return GPIOContext::instance().gpio();
-}
+    ShadowBackend _backend;
+    RealtimeWorker* _realtime;
+    APA102Chain _chain;
+    RGB _rgb;
+    uint8_t _brightness;
+    uint8_t _duty;
+    uint8_t _slot;
+    bool _has_button;
+    bool _has_led;
+};
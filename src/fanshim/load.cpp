@@ -0,0 +1,186 @@
+#include "fanshim/load.hpp"
+
+#include "fanshim/attribute.hpp"
+#include "fanshim/logger.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+
+inline constexpr size_t STAT_BUFFER_SIZE = 512;
+inline constexpr size_t LOADAVG_BUFFER_SIZE = 128;
+inline constexpr size_t STAT_FIELDS = 10;
+inline constexpr size_t IDLE_FIELD = 3;
+inline constexpr size_t IOWAIT_FIELD = 4;
+inline constexpr size_t GUEST_FIELD = 8;
+
+
+static uint32_t countCPUs(const std::filesystem::path& stat_file)
+{
+    std::ifstream stream(stat_file, std::ios::in);
+    std::string line;
+    uint32_t cpus = 0;
+    while (std::getline(stream, line)) {
+        if (line.size() > 3 && line.compare(0, 3, "cpu") == 0 && line[3] >= '0' && line[3] <= '9') {
+            cpus++;
+        }
+    }
+    return cpus ? cpus : 1;
+}
+
+
+LoadMonitor::LoadMonitor(const std::filesystem::path& proc_root, double threshold, std::chrono::milliseconds duration)
+    : _proc_root(proc_root),
+      _threshold(threshold),
+      _duration(duration),
+      _stat_fd(NO_FD),
+      _loadavg_fd(NO_FD),
+      _cpus(1),
+      _busy(0),
+      _total(0),
+      _utilisation(0.0),
+      _load_average(0.0),
+      _above_since(0),
+      _above(false),
+      _high(false)
+{}
+
+LoadMonitor::~LoadMonitor()
+{
+    close();
+}
+
+bool LoadMonitor::open()
+{
+    close();
+
+    _stat_fd = openAttribute(_proc_root / "stat");
+    _loadavg_fd = openAttribute(_proc_root / "loadavg");
+    if (_stat_fd < 0 || _loadavg_fd < 0) {
+        close();
+        return false;
+    }
+
+    _cpus = countCPUs(_proc_root / "stat");
+
+    // Prime the counters so that the first sample measures utilisation over one interval rather than since boot.
+    if (!_readStat(_busy, _total)) {
+        logger().error("Failed to parse {}", (_proc_root / "stat").native());
+        close();
+        return false;
+    }
+
+    logger().warn("Monitoring load from {} across {} CPU(s)", _proc_root.native(), _cpus);
+    return true;
+}
+
+void LoadMonitor::close()
+{
+    closeAttribute(_stat_fd);
+    closeAttribute(_loadavg_fd);
+}
+
+bool LoadMonitor::isOpen() const
+{
+    return _stat_fd >= 0 && _loadavg_fd >= 0;
+}
+
+bool LoadMonitor::sample(std::chrono::milliseconds now)
+{
+    uint64_t busy = 0;
+    uint64_t total = 0;
+    if (!isOpen() || !_readStat(busy, total) || !_readLoadAverage(_load_average)) {
+        return false;
+    }
+
+    // Counters only move forward; if they did not (a fake or replaced stat file), keep the previous utilisation.
+    if (total > _total && busy >= _busy) {
+        _utilisation = 100.0 * (busy - _busy) / (total - _total);
+    }
+    _busy = busy;
+    _total = total;
+
+    bool above = _utilisation >= _threshold;
+    if (above && !_above) {
+        _above_since = now;
+    }
+    _above = above;
+
+    bool loaded = _load_average * 100.0 >= _threshold;
+    bool sustained = _above && now - _above_since >= _duration;
+
+    bool high = _high ? (_above || loaded) : (sustained || loaded);
+    if (high == _high) {
+        return false;
+    }
+
+    _high = high;
+    return true;
+}
+
+bool LoadMonitor::high() const
+{
+    return _high;
+}
+
+double LoadMonitor::utilisation() const
+{
+    return _utilisation;
+}
+
+double LoadMonitor::loadAverage() const
+{
+    return _load_average;
+}
+
+bool LoadMonitor::_readStat(uint64_t& busy, uint64_t& total) const
+{
+    char buffer[STAT_BUFFER_SIZE];
+    if (!readAttribute(_stat_fd, buffer, sizeof(buffer)) || std::strncmp(buffer, "cpu ", 4) != 0) {
+        return false;
+    }
+
+    // The aggregate line is: cpu user nice system idle iowait irq softirq steal guest guest_nice. Guest time is already included in user and nice.
+    uint64_t fields[STAT_FIELDS] = {};
+    char* cursor = buffer + 4;
+    for (size_t i = 0; i < STAT_FIELDS; ++i) {
+        char* end = nullptr;
+        fields[i] = std::strtoull(cursor, &end, 10);
+        if (end == cursor) {
+            if (i <= IOWAIT_FIELD) {
+                return false;
+            }
+            break;
+        }
+        cursor = end;
+    }
+
+    total = 0;
+    for (size_t i = 0; i < GUEST_FIELD; ++i) {
+        total += fields[i];
+    }
+    busy = total - fields[IDLE_FIELD] - fields[IOWAIT_FIELD];
+    return true;
+}
+
+bool LoadMonitor::_readLoadAverage(double& load_average) const
+{
+    char buffer[LOADAVG_BUFFER_SIZE];
+    if (!readAttribute(_loadavg_fd, buffer, sizeof(buffer))) {
+        return false;
+    }
+
+    char* end = nullptr;
+    double load = std::strtod(buffer, &end);
+    if (end == buffer) {
+        return false;
+    }
+
+    load_average = load / _cpus;
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+
+/**
+ * Samples CPU utilisation from /proc/stat and the load average from /proc/loadavg, to anticipate heat before the sensors report it.
+ *
+ * Both files are kept open and re-read from the start on every sample. Load is considered high once utilisation has stayed at or above the threshold for the
+ * configured duration, or as soon as the one-minute load average per CPU reaches it, and stays high until both fall below the threshold.
+ */
+class LoadMonitor
+{
+public:
+    LoadMonitor(const std::filesystem::path& proc_root, double threshold, std::chrono::milliseconds duration);
+    ~LoadMonitor();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    /**
+     * Takes a sample at `now` and returns true if the high-load state changed.
+     */
+    bool sample(std::chrono::milliseconds now);
+
+    bool high() const;
+
+    /**
+     * Utilisation across all CPUs since the previous sample, in percent.
+     */
+    double utilisation() const;
+
+    /**
+     * The one-minute load average divided by the number of CPUs.
+     */
+    double loadAverage() const;
+
+private:
+    LoadMonitor(const LoadMonitor&) = delete;
+    LoadMonitor(LoadMonitor&&) = delete;
+    LoadMonitor& operator=(const LoadMonitor&) = delete;
+    LoadMonitor& operator=(LoadMonitor&&) = delete;
+
+    bool _readStat(uint64_t& busy, uint64_t& total) const;
+    bool _readLoadAverage(double& load_average) const;
+
+    std::filesystem::path _proc_root;
+    double _threshold;
+    std::chrono::milliseconds _duration;
+    int32_t _stat_fd;
+    int32_t _loadavg_fd;
+    uint32_t _cpus;
+    uint64_t _busy;
+    uint64_t _total;
+    double _utilisation;
+    double _load_average;
+    std::chrono::milliseconds _above_since;
+    bool _above;
+    bool _high;
+};
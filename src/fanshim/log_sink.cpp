@@ -0,0 +1,230 @@
+#include "fanshim/log_sink.hpp"
+
+#include <fcntl.h>
+#include <spdlog/common.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+inline constexpr size_t COMPRESSION_CHUNK_SIZE = 64 * 1024;
+inline constexpr std::string_view COMPRESSED_SUFFIX = ".gz";
+inline constexpr std::string_view TEMPORARY_SUFFIX = ".tmp";
+
+
+static std::filesystem::path rotatedPath(const std::filesystem::path& path, size_t index, std::string_view suffix = "")
+{
+    return path.native() + "." + std::to_string(index) + std::string(suffix);
+}
+
+/**
+ * Compresses `source` into `destination` and removes it. The archive is written under a temporary name first, so a crash never leaves a truncated archive
+ * behind.
+ */
+static void compressFile(const std::filesystem::path& source, const std::filesystem::path& destination)
+{
+    std::filesystem::path temporary = destination.native() + std::string(TEMPORARY_SUFFIX);
+    int32_t input = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+        return;
+    }
+
+    gzFile output = gzopen(temporary.c_str(), "wb9");
+    if (!output) {
+        ::close(input);
+        return;
+    }
+
+    std::vector<char> chunk(COMPRESSION_CHUNK_SIZE);
+    bool complete = true;
+    for (;;) {
+        ssize_t length = ::read(input, chunk.data(), chunk.size());
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            complete = length == 0;
+            break;
+        }
+        if (gzwrite(output, chunk.data(), static_cast<unsigned>(length)) != length) {
+            complete = false;
+            break;
+        }
+    }
+
+    ::close(input);
+    complete = gzclose(output) == Z_OK && complete;
+
+    std::error_code ec;
+    if (!complete) {
+        std::filesystem::remove(temporary, ec);
+        return;
+    }
+
+    std::filesystem::rename(temporary, destination, ec);
+    if (!ec) {
+        std::filesystem::remove(source, ec);
+    }
+}
+
+
+BufferedFileSink::BufferedFileSink(const std::filesystem::path& path, size_t buffer_size, std::chrono::seconds flush_interval, size_t max_size, size_t max_files)
+    : _path(path),
+      _buffer(std::max(buffer_size, LOG_BLOCK_SIZE)),
+      _used(0),
+      _flush_interval(flush_interval),
+      _last_flush(std::chrono::steady_clock::now()),
+      _max_size(max_size),
+      _max_files(std::max<size_t>(max_files, 1)),
+      _file_size(0),
+      _fd(-1),
+      _writes(0),
+      _compressor()
+{
+    _open();
+}
+
+BufferedFileSink::~BufferedFileSink()
+{
+    sync();
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+    if (_compressor.joinable()) {
+        _compressor.join();
+    }
+}
+
+void BufferedFileSink::sync()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    _writeAll();
+}
+
+uint64_t BufferedFileSink::writes() const
+{
+    return _writes;
+}
+
+void BufferedFileSink::sink_it_(const spdlog::details::log_msg& message)
+{
+    spdlog::memory_buf_t formatted;
+    formatter_->format(message, formatted);
+
+    if (formatted.size() > _buffer.size() - _used) {
+        // Write as many whole blocks as the buffer holds, keeping the tail for the next batch, so that the file grows a block at a time.
+        size_t block_end = (_file_size + _used) / LOG_BLOCK_SIZE * LOG_BLOCK_SIZE;
+        _write(block_end > _file_size ? block_end - _file_size : 0);
+        if (formatted.size() > _buffer.size() - _used) {
+            _writeAll();
+        }
+    }
+
+    if (formatted.size() > _buffer.size()) {
+        _writeData(formatted.data(), formatted.size());
+    }
+    else {
+        memcpy(_buffer.data() + _used, formatted.data(), formatted.size());
+        _used += formatted.size();
+    }
+
+    if (std::chrono::steady_clock::now() - _last_flush >= _flush_interval) {
+        _writeAll();
+    }
+}
+
+void BufferedFileSink::flush_()
+{
+    if (std::chrono::steady_clock::now() - _last_flush >= _flush_interval) {
+        _writeAll();
+    }
+}
+
+void BufferedFileSink::_open()
+{
+    _fd = ::open(_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw spdlog::spdlog_ex("Failed to open " + _path.native(), errno);
+    }
+
+    struct stat status = {};
+    _file_size = ::fstat(_fd, &status) == 0 ? static_cast<size_t>(status.st_size) : 0;
+}
+
+void BufferedFileSink::_writeData(const char* data, size_t length)
+{
+    while (length > 0 && _fd >= 0) {
+        ssize_t written = ::write(_fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            // Nowhere to report a failure to write the log; drop the batch rather than spin.
+            return;
+        }
+
+        _writes++;
+        _file_size += written;
+        data += written;
+        length -= written;
+    }
+}
+
+void BufferedFileSink::_write(size_t length)
+{
+    if (length == 0) {
+        return;
+    }
+
+    _writeData(_buffer.data(), length);
+    memmove(_buffer.data(), _buffer.data() + length, _used - length);
+    _used -= length;
+
+    if (_file_size >= _max_size) {
+        _rotate();
+    }
+}
+
+void BufferedFileSink::_writeAll()
+{
+    _write(_used);
+    _last_flush = std::chrono::steady_clock::now();
+}
+
+void BufferedFileSink::_rotate()
+{
+    // Only one file is compressed at a time, and it must be finished before the archives are renumbered.
+    if (_compressor.joinable()) {
+        _compressor.join();
+    }
+
+    ::close(_fd);
+    _fd = -1;
+
+    std::error_code ec;
+    for (size_t i = _max_files; i > 1; --i) {
+        std::filesystem::rename(rotatedPath(_path, i - 1, COMPRESSED_SUFFIX), rotatedPath(_path, i, COMPRESSED_SUFFIX), ec);
+    }
+
+    std::filesystem::path rotated = rotatedPath(_path, 1);
+    std::filesystem::rename(_path, rotated, ec);
+    _open();
+
+    if (!ec) {
+        _compressor = std::thread(compressFile, rotated, rotatedPath(_path, 1, COMPRESSED_SUFFIX));
+    }
+}
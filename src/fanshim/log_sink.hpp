@@ -0,0 +1,68 @@
+#pragma once
+
+#include <spdlog/sinks/base_sink.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+inline constexpr size_t LOG_BLOCK_SIZE = 4096;
+
+/**
+ * A log file sink for flash storage. Records collect in a fixed RAM buffer and reach the file in large batches: when the buffer fills, only whole blocks are
+ * written, and the rest is written once `flush_interval` has passed or sync() is called. Once the file reaches `max_size` it is rotated and compressed with
+ * gzip on a background thread, keeping up to `max_files` compressed files.
+ */
+class BufferedFileSink : public spdlog::sinks::base_sink<std::mutex>
+{
+public:
+    BufferedFileSink(const std::filesystem::path& path, size_t buffer_size, std::chrono::seconds flush_interval, size_t max_size, size_t max_files);
+    ~BufferedFileSink() override;
+
+    /**
+     * Writes everything buffered, regardless of the flush interval. Used on shutdown and when the driver crashes.
+     */
+    void sync();
+
+    /**
+     * The number of write calls issued to the file.
+     */
+    uint64_t writes() const;
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& message) override;
+
+    /**
+     * spdlog flushes every sink periodically; this only writes once the flush interval has passed, so the periodic flush does not defeat batching.
+     */
+    void flush_() override;
+
+private:
+    BufferedFileSink(const BufferedFileSink&) = delete;
+    BufferedFileSink(BufferedFileSink&&) = delete;
+    BufferedFileSink& operator=(const BufferedFileSink&) = delete;
+    BufferedFileSink& operator=(BufferedFileSink&&) = delete;
+
+    void _open();
+    void _writeData(const char* data, size_t length);
+    void _write(size_t length);
+    void _writeAll();
+    void _rotate();
+
+    std::filesystem::path _path;
+    std::vector<char> _buffer;
+    size_t _used;
+    std::chrono::seconds _flush_interval;
+    std::chrono::steady_clock::time_point _last_flush;
+    size_t _max_size;
+    size_t _max_files;
+    size_t _file_size;
+    int32_t _fd;
+    uint64_t _writes;
+    std::thread _compressor;
+};
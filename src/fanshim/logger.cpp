@@ -1,11 +1,15 @@
 #include "fanshim/logger.hpp"
 
+#include "fanshim/log_sink.hpp"
+
 #include <execinfo.h>
 #include <signal.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/spdlog.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <cstdlib>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -17,10 +21,51 @@ inline constexpr std::string_view IDENTIFIER = "fanshim";
 inline constexpr std::string_view LOG_FILE = "/var/log/devices/fanshim.log";
 inline constexpr std::string_view LOG_PATTERN = "[%Y.%m.%d %H:%M:%S.%e] (%L): %v";
 inline constexpr std::string_view LOG_LEVEL_ENVIRONMENT_VARIABLE = "SHIM_LOG_LEVEL";
+inline constexpr std::string_view LOG_FILE_ENVIRONMENT_VARIABLE = "SHIM_LOG_FILE";
+inline constexpr std::string_view LOG_STORAGE_ENVIRONMENT_VARIABLE = "SHIM_LOG_STORAGE";
+inline constexpr std::string_view LOG_BUFFER_ENVIRONMENT_VARIABLE = "SHIM_LOG_BUFFER_KB";
+inline constexpr std::string_view LOG_FLUSH_ENVIRONMENT_VARIABLE = "SHIM_LOG_FLUSH_SECONDS";
+inline constexpr std::string_view LOG_FILES_ENVIRONMENT_VARIABLE = "SHIM_LOG_MAX_FILES";
+inline constexpr std::string_view BUFFERED_STORAGE = "buffered";
 inline constexpr size_t BACKTRACE_SIZE = 4;
 inline constexpr size_t FILE_SIZE_MB = 1 * 1024 * 1024;
 inline constexpr size_t MAX_LOG_FILES = 3;
+inline constexpr size_t DEFAULT_LOG_BUFFER_KB = 256;
+inline constexpr size_t DEFAULT_LOG_FLUSH_SECONDS = 300;
+inline constexpr size_t DEFAULT_COMPRESSED_LOG_FILES = 10;
+
+
+static bool host_logger = false;
+
+static size_t environmentValue(std::string_view name, size_t fallback)
+{
+    const char* value = getenv(name.data());
+    if (!value) {
+        return fallback;
+    }
 
+    char* end = nullptr;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+        fprintf(stderr, "Ignoring invalid %s: %s\n", name.data(), value);
+        return fallback;
+    }
+    return static_cast<size_t>(parsed);
+}
+
+static std::shared_ptr<spdlog::sinks::sink> createFileSink(const char* log_file)
+{
+    const char* storage = getenv(LOG_STORAGE_ENVIRONMENT_VARIABLE.data());
+    if (storage && storage == BUFFERED_STORAGE) {
+        return std::make_shared<BufferedFileSink>(log_file,
+                                                  environmentValue(LOG_BUFFER_ENVIRONMENT_VARIABLE, DEFAULT_LOG_BUFFER_KB) * 1024,
+                                                  std::chrono::seconds(environmentValue(LOG_FLUSH_ENVIRONMENT_VARIABLE, DEFAULT_LOG_FLUSH_SECONDS)),
+                                                  FILE_SIZE_MB,
+                                                  environmentValue(LOG_FILES_ENVIRONMENT_VARIABLE, DEFAULT_COMPRESSED_LOG_FILES));
+    }
+
+    return std::make_shared<spdlog::sinks::rotating_file_sink_mt>(log_file, FILE_SIZE_MB, environmentValue(LOG_FILES_ENVIRONMENT_VARIABLE, MAX_LOG_FILES));
+}
 
 void logSignal(int32_t signum, siginfo_t* info, void* context)
 {
@@ -45,6 +90,11 @@ void logSignal(int32_t signum, siginfo_t* info, void* context)
 
 LoggingInterface::LoggingInterface() : _level(LogLevel::WARN)
 {
+    if (host_logger) {
+        _level = static_cast<LogLevel>(spdlog::get_level());
+        return;
+    }
+
     char* level = getenv(LOG_LEVEL_ENVIRONMENT_VARIABLE.data());
     if (level) {
         try {
@@ -68,9 +118,13 @@ LoggingInterface::LoggingInterface() : _level(LogLevel::WARN)
 
     std::shared_ptr<spdlog::logger> logger;
 
+    const char* log_file = getenv(LOG_FILE_ENVIRONMENT_VARIABLE.data());
+    if (!log_file) {
+        log_file = LOG_FILE.data();
+    }
+
     try {
-        auto file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(LOG_FILE.data(), FILE_SIZE_MB, MAX_LOG_FILES);
-        spdlog::sinks_init_list sinks = {file_sink};
+        spdlog::sinks_init_list sinks = {createFileSink(log_file)};
         logger = std::make_shared<spdlog::logger>(IDENTIFIER.data(), sinks);
     }
     catch (const spdlog::spdlog_ex& ex) {
@@ -87,6 +141,14 @@ LoggingInterface::LoggingInterface() : _level(LogLevel::WARN)
 void LoggingInterface::flush()
 {
     spdlog::default_logger()->flush();
+
+    // The periodic flush leaves a buffered sink alone until its interval has passed, so an explicit flush has to sync it.
+    for (const auto& sink : spdlog::default_logger()->sinks()) {
+        auto buffered = std::dynamic_pointer_cast<BufferedFileSink>(sink);
+        if (buffered) {
+            buffered->sync();
+        }
+    }
 }
 
 void LoggingInterface::setLevel(LogLevel level)
@@ -101,6 +163,11 @@ LoggingContext& LoggingContext::instance()
     return context;
 }
 
+void LoggingContext::useHostLogger()
+{
+    host_logger = true;
+}
+
 LoggingInterface& LoggingContext::logger()
 {
     return _logger;
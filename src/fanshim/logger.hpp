@@ -48,6 +48,12 @@ public:
         spdlog::error(fmt, args...);
     }
 
+    template <typename... Args>
+    inline void critical(const char* fmt, const Args&... args)
+    {
+        spdlog::critical(fmt, args...);
+    }
+
     void setLevel(LogLevel level);
 
 private:
@@ -59,6 +65,12 @@ class LoggingContext
 public:
     static LoggingContext& instance();
 
+    /**
+     * Logs through spdlog's default logger, as the host process configured it, instead of installing the driver's log file, level and crash handlers. Only
+     * takes effect if called before anything is logged.
+     */
+    static void useHostLogger();
+
     LoggingInterface& logger();
 
 private:
@@ -0,0 +1,135 @@
+#include "fanshim/metrics.hpp"
+
+#include <fcntl.h>
+#include <spdlog/fmt/fmt.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <string_view>
+
+
+inline constexpr std::string_view FAN_HEADER = "# HELP cpu_fanshim text file output: fan state.\n# TYPE cpu_fanshim gauge\n";
+inline constexpr std::string_view TEMP_HEADER = "# HELP cpu_temp_fanshim text file output: temp.\n# TYPE cpu_temp_fanshim gauge\n";
+inline constexpr std::string_view FILTERED_TEMP_HEADER = "# HELP cpu_fanshim_temp_filtered text file output: filtered temperature.\n# TYPE cpu_fanshim_temp_filtered gauge\n";
+inline constexpr std::string_view RAW_TEMP_HEADER = "# HELP cpu_fanshim_temp_raw text file output: last raw temperature sample.\n# TYPE cpu_fanshim_temp_raw gauge\n";
+inline constexpr std::string_view SENSOR_FAILURES_HEADER = "# HELP cpu_fanshim_sensor_failures_total text file output: failed temperature reads.\n# TYPE cpu_fanshim_sensor_failures_total counter\n";
+inline constexpr std::string_view REJECTED_SAMPLES_HEADER = "# HELP cpu_fanshim_rejected_samples_total text file output: temperature samples rejected as spikes.\n# TYPE cpu_fanshim_rejected_samples_total counter\n";
+inline constexpr std::string_view TRANSITIONS_HEADER = "# HELP cpu_fanshim_transitions_total text file output: fan state transitions.\n# TYPE cpu_fanshim_transitions_total counter\n";
+inline constexpr std::string_view DWELL_HOLDS_HEADER = "# HELP cpu_fanshim_dwell_holds_total text file output: fan transitions held back by the minimum dwell time.\n# TYPE cpu_fanshim_dwell_holds_total counter\n";
+inline constexpr std::string_view READS_SAVED_HEADER = "# HELP cpu_fanshim_gpio_reads_saved_total text file output: gpio reads answered from the shadow.\n# TYPE cpu_fanshim_gpio_reads_saved_total counter\n";
+inline constexpr std::string_view MISMATCHES_HEADER = "# HELP cpu_fanshim_gpio_mismatches_total text file output: gpio lines changed outside the driver.\n# TYPE cpu_fanshim_gpio_mismatches_total counter\n";
+inline constexpr std::string_view NEAR_TRIP_HEADER = "# HELP cpu_fanshim_near_trip text file output: temperature within the margin of a trip point.\n# TYPE cpu_fanshim_near_trip gauge\n";
+inline constexpr std::string_view THROTTLED_HEADER = "# HELP cpu_fanshim_throttled text file output: cpu frequency throttled.\n# TYPE cpu_fanshim_throttled gauge\n";
+inline constexpr std::string_view THROTTLED_TIME_HEADER = "# HELP cpu_fanshim_throttled_seconds_total text file output: time throttled.\n# TYPE cpu_fanshim_throttled_seconds_total counter\n";
+inline constexpr std::string_view THROTTLE_EVENTS_HEADER = "# HELP cpu_fanshim_throttle_events_total text file output: throttling events.\n# TYPE cpu_fanshim_throttle_events_total counter\n";
+inline constexpr std::string_view FREQUENCY_HEADER = "# HELP cpu_fanshim_frequency_ratio text file output: lowest cpu frequency over maximum.\n# TYPE cpu_fanshim_frequency_ratio gauge\n";
+
+
+void serializeMetrics(fmt::memory_buffer& buffer, const std::vector<std::unique_ptr<Channel>>& channels, const ThrottleMonitor& throttle)
+{
+    auto out = std::back_inserter(buffer);
+
+    fmt::format_to(out, "{}", FAN_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim{{channel=\"{}\"}} {:d}\n", channel->name(), channel->fan());
+    }
+
+    fmt::format_to(out, "{}", TEMP_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_temp_fanshim{{channel=\"{}\"}} {}\n", channel->name(), std::trunc(channel->temperature()));
+    }
+
+    fmt::format_to(out, "{}", FILTERED_TEMP_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_temp_filtered{{channel=\"{}\"}} {:.3f}\n", channel->name(), channel->temperature());
+    }
+
+    fmt::format_to(out, "{}", RAW_TEMP_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_temp_raw{{channel=\"{}\"}} {:.3f}\n", channel->name(), channel->rawTemperature());
+    }
+
+    fmt::format_to(out, "{}", SENSOR_FAILURES_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_sensor_failures_total{{channel=\"{}\"}} {}\n", channel->name(), channel->filterStats().failures);
+    }
+
+    fmt::format_to(out, "{}", REJECTED_SAMPLES_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_rejected_samples_total{{channel=\"{}\"}} {}\n", channel->name(), channel->filterStats().rejections);
+    }
+
+    fmt::format_to(out, "{}", TRANSITIONS_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_transitions_total{{channel=\"{}\"}} {}\n", channel->name(), channel->stats().fan_transitions);
+    }
+
+    fmt::format_to(out, "{}", DWELL_HOLDS_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_dwell_holds_total{{channel=\"{}\"}} {}\n", channel->name(), channel->stats().dwell_holds);
+    }
+
+    fmt::format_to(out, "{}", READS_SAVED_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_gpio_reads_saved_total{{channel=\"{}\"}} {}\n", channel->name(), channel->gpioStats().reads_saved);
+    }
+
+    fmt::format_to(out, "{}", MISMATCHES_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_gpio_mismatches_total{{channel=\"{}\"}} {}\n", channel->name(), channel->gpioStats().mismatches);
+    }
+
+    if (!throttle.isOpen()) {
+        return;
+    }
+
+    fmt::format_to(out, "{}", NEAR_TRIP_HEADER);
+    for (const auto& channel : channels) {
+        fmt::format_to(out, "cpu_fanshim_near_trip{{channel=\"{}\"}} {:d}\n", channel->name(), channel->nearTripPoint());
+    }
+
+    fmt::format_to(out, "{}cpu_fanshim_throttled {:d}\n", THROTTLED_HEADER, throttle.throttled());
+    fmt::format_to(out, "{}cpu_fanshim_throttled_seconds_total {:.6f}\n", THROTTLED_TIME_HEADER, throttle.throttledTime().count() / 1000.0);
+    fmt::format_to(out, "{}cpu_fanshim_throttle_events_total {}\n", THROTTLE_EVENTS_HEADER, throttle.throttleEvents());
+    fmt::format_to(out, "{}cpu_fanshim_frequency_ratio {:.6f}\n", FREQUENCY_HEADER, throttle.frequencyRatio());
+}
+
+MetricsFile::MetricsFile(const std::filesystem::path& output_file) : _output_file(output_file), _buffer()
+{}
+
+bool MetricsFile::write(const std::vector<std::unique_ptr<Channel>>& channels, const ThrottleMonitor& throttle)
+{
+    if (_output_file.empty()) {
+        return false;
+    }
+
+    _buffer.clear();
+    serializeMetrics(_buffer, channels, throttle);
+
+    int32_t fd = ::open(_output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    const char* data = _buffer.data();
+    size_t remaining = _buffer.size();
+    while (remaining > 0) {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            ::close(fd);
+            return false;
+        }
+        data += written;
+        remaining -= written;
+    }
+
+    ::close(fd);
+    return true;
+}
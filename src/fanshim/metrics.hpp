@@ -0,0 +1,39 @@
+#pragma once
+
+#include "fanshim/channel.hpp"
+#include "fanshim/throttle.hpp"
+
+#include <spdlog/fmt/fmt.h>
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+
+/**
+ * Appends the state of every channel, and the throttling state if it is being monitored, to `buffer` in the Prometheus text exposition format.
+ */
+void serializeMetrics(fmt::memory_buffer& buffer, const std::vector<std::unique_ptr<Channel>>& channels, const ThrottleMonitor& throttle);
+
+/**
+ * The monitoring output file. Metrics are serialized into a buffer kept between writes, so after the first write the file is replaced without allocating.
+ */
+class MetricsFile
+{
+public:
+    MetricsFile(const std::filesystem::path& output_file);
+
+    /**
+     * Replaces the contents of the output file, if there is one, with the current metrics.
+     */
+    bool write(const std::vector<std::unique_ptr<Channel>>& channels, const ThrottleMonitor& throttle);
+
+private:
+    MetricsFile(const MetricsFile&) = delete;
+    MetricsFile(MetricsFile&&) = delete;
+    MetricsFile& operator=(const MetricsFile&) = delete;
+    MetricsFile& operator=(MetricsFile&&) = delete;
+
+    std::filesystem::path _output_file;
+    fmt::memory_buffer _buffer;
+};
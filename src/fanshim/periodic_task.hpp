@@ -0,0 +1,69 @@
+#pragma once
+
+#include "fanshim/clock.hpp"
+
+#include <uv.h>
+
+#include <chrono>
+#include <cstdint>
+
+
+/**
+ * A uv_timer_cb that calls `Method` on the object stored in the handle's data, so timers dispatch to their owner without type erasure or global state.
+ */
+template <typename Owner, void (Owner::*Method)()>
+void dispatchTimer(uv_timer_t* handle)
+{
+    (static_cast<Owner*>(handle->data)->*Method)();
+}
+
+/**
+ * Calls `Method` on its owner at a fixed interval, on the owner's loop and clock.
+ */
+template <typename Owner, void (Owner::*Method)()>
+class PeriodicTask
+{
+public:
+    PeriodicTask(uv_loop_t* loop, Clock& clock, Owner& owner) : _clock(clock), _handle()
+    {
+        uv_timer_init(loop, &_handle);
+        _handle.data = &owner;
+    }
+
+    ~PeriodicTask()
+    {
+        stop();
+    }
+
+    /**
+     * Runs the task after `delay`, then every `interval`. Restarts the task if it is already running.
+     */
+    int32_t start(std::chrono::milliseconds interval, std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+    {
+        return _clock.start(&_handle, dispatchTimer<Owner, Method>, delay.count(), interval.count());
+    }
+
+    void stop()
+    {
+        _clock.stop(&_handle);
+    }
+
+    /**
+     * Stops the task and closes its timer. `callback` receives the timer, whose data is the owner, once the loop has closed it; the task must not be
+     * destroyed before then.
+     */
+    void close(uv_close_cb callback)
+    {
+        stop();
+        uv_close(reinterpret_cast<uv_handle_t*>(&_handle), callback);
+    }
+
+private:
+    PeriodicTask(const PeriodicTask&) = delete;
+    PeriodicTask(PeriodicTask&&) = delete;
+    PeriodicTask& operator=(const PeriodicTask&) = delete;
+    PeriodicTask& operator=(PeriodicTask&&) = delete;
+
+    Clock& _clock;
+    uv_timer_t _handle;
+};
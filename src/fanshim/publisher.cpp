@@ -0,0 +1,95 @@
+#include "fanshim/publisher.hpp"
+
+#include "fanshim/logger.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+
+
+inline constexpr mode_t SEGMENT_PERMISSIONS = 0644;
+
+
+StatusPublisher::StatusPublisher() : _segment(nullptr), _name()
+{}
+
+StatusPublisher::~StatusPublisher()
+{
+    close();
+}
+
+bool StatusPublisher::open(const std::string& name)
+{
+    close();
+    if (name.empty()) {
+        logger().debug("Status segment disabled");
+        return false;
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, SEGMENT_PERMISSIONS);
+    if (fd < 0) {
+        logger().error("Failed to open status segment {}: {}", name, std::strerror(errno));
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(StatusSegment)) != 0) {
+        logger().error("Failed to size status segment {}: {}", name, std::strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    void* address = mmap(nullptr, sizeof(StatusSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        logger().error("Failed to map status segment {}: {}", name, std::strerror(errno));
+        return false;
+    }
+
+    std::memset(address, 0, sizeof(StatusSegment));
+    _segment = new (address) StatusSegment();
+    _segment->version = STATUS_VERSION;
+    _segment->size = sizeof(StatusSegment);
+    _segment->sequence.store(0, std::memory_order_relaxed);
+
+    // Readers validate the magic last, so it is only published once the rest of the header is in place.
+    std::atomic_thread_fence(std::memory_order_release);
+    _segment->magic = STATUS_MAGIC;
+
+    _name = name;
+    logger().warn("Publishing status to shared memory segment {}", _name);
+    return true;
+}
+
+void StatusPublisher::close()
+{
+    if (!_segment) {
+        return;
+    }
+
+    munmap(_segment, sizeof(StatusSegment));
+    shm_unlink(_name.c_str());
+    _segment = nullptr;
+    _name.clear();
+}
+
+void StatusPublisher::publish(const StatusSnapshot& snapshot)
+{
+    if (!_segment) {
+        return;
+    }
+
+    uint32_t sequence = _segment->sequence.load(std::memory_order_relaxed);
+    _segment->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _segment->snapshot = snapshot;
+
+    _segment->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "fanshim/status.hpp"
+
+#include <string>
+
+
+/**
+ * Owns the driver's side of the shared-memory status segment.
+ */
+class StatusPublisher
+{
+public:
+    StatusPublisher();
+    ~StatusPublisher();
+
+    bool open(const std::string& name);
+    void close();
+
+    void publish(const StatusSnapshot& snapshot);
+
+private:
+    StatusPublisher(const StatusPublisher&) = delete;
+    StatusPublisher(StatusPublisher&&) = delete;
+    StatusPublisher& operator=(const StatusPublisher&) = delete;
+    StatusPublisher& operator=(StatusPublisher&&) = delete;
+
+    StatusSegment* _segment;
+    std::string _name;
+};
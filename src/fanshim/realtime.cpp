@@ -0,0 +1,296 @@
+#include "fanshim/realtime.hpp"
+
+#include "fanshim/gpio.hpp"
+#include "fanshim/logger.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+
+inline constexpr uint64_t NANOSECONDS_PER_SECOND = 1000000000;
+inline constexpr size_t STACK_PREFAULT_SIZE = 64 * 1024;
+inline constexpr uint8_t FRESH_FRAME = 0x80;
+inline constexpr uint8_t FRAME_INDEX = 0x03;
+
+
+static uint64_t monotonicNow()
+{
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
+
+static void prefaultStack()
+{
+    // Touch the stack the worker will use so that, with memory locked, it never page faults once running.
+    uint8_t stack[STACK_PREFAULT_SIZE];
+    memset(stack, 0, sizeof(stack));
+    asm volatile("" : : "r"(stack) : "memory");
+}
+
+
+RealtimeWorker::RealtimeWorker(uint8_t priority, int32_t cpu, bool lock_memory, uint32_t pwm_frequency)
+    : _priority(priority),
+      _cpu(cpu),
+      _lock_memory(lock_memory),
+      _period_ns(NANOSECONDS_PER_SECOND / std::max<uint32_t>(pwm_frequency, 1)),
+      _slots(),
+      _frames(),
+      _slot_count(0),
+      _queue(),
+      _thread(),
+      _running(false),
+      _fifo(false),
+      _pinned(false),
+      _locked(false),
+      _wakeups(0),
+      _total_lateness_ns(0),
+      _max_lateness_ns(0),
+      _dropped(0)
+{}
+
+RealtimeWorker::~RealtimeWorker()
+{
+    stop();
+}
+
+uint8_t RealtimeWorker::attach(GPIOBackend& backend, size_t led_count)
+{
+    _slots[_slot_count] = {&backend, 0, false};
+    for (auto& frame : _frames[_slot_count].frames) {
+        frame = {APA102Chain(led_count), 0};
+    }
+    return static_cast<uint8_t>(_slot_count++);
+}
+
+void RealtimeWorker::start()
+{
+    if (_running.exchange(true)) {
+        return;
+    }
+
+    if (_lock_memory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            _locked = true;
+        }
+        else {
+            logger().warn("Failed to lock memory for the realtime worker: {}", strerror(errno));
+        }
+    }
+
+    _thread = std::thread(&RealtimeWorker::_run, this);
+
+    sched_param parameters = {};
+    parameters.sched_priority = _priority;
+    int32_t result = pthread_setschedparam(_thread.native_handle(), SCHED_FIFO, &parameters);
+    if (result == 0) {
+        _fifo = true;
+    }
+    else {
+        logger().warn("Realtime worker falling back to normal priority, SCHED_FIFO {} denied: {}", _priority, strerror(result));
+    }
+
+    if (_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(_cpu, &cpus);
+        result = pthread_setaffinity_np(_thread.native_handle(), sizeof(cpus), &cpus);
+        if (result == 0) {
+            _pinned = true;
+        }
+        else {
+            logger().warn("Failed to pin the realtime worker to CPU {}: {}", _cpu, strerror(result));
+        }
+    }
+
+    logger().warn("Realtime worker started for {} channel(s) [FIFO: {}, Pinned: {}, Locked: {}]", _slot_count, _fifo.load(), _pinned.load(), _locked.load());
+}
+
+void RealtimeWorker::stop()
+{
+    if (!_running.exchange(false)) {
+        return;
+    }
+
+    _thread.join();
+
+    RealtimeStatus final_status = status();
+    logger().warn("Realtime worker stopped [Wakeups: {}, Average Lateness: {} ns, Max Lateness: {} ns, Dropped: {}]",
+                  final_status.wakeups,
+                  final_status.average_lateness_ns,
+                  final_status.max_lateness_ns,
+                  final_status.dropped);
+}
+
+bool RealtimeWorker::setDuty(uint8_t slot, uint8_t duty)
+{
+    return _push({OutputCommand::Type::FAN_DUTY, slot, std::min(duty, MAX_DUTY)});
+}
+
+void RealtimeWorker::writeFrame(uint8_t slot, uint8_t brightness, const APA102Chain& chain)
+{
+    if (slot >= _slot_count) {
+        return;
+    }
+
+    // The chains have the same length, so the copy reuses the back frame's storage.
+    FrameBuffer& buffer = _frames[slot];
+    LEDFrame& frame = buffer.frames[buffer.back];
+    frame.chain = chain;
+    frame.brightness = brightness;
+    buffer.back = buffer.middle.exchange(buffer.back | FRESH_FRAME, std::memory_order_acq_rel) & FRAME_INDEX;
+}
+
+RealtimeStatus RealtimeWorker::status() const
+{
+    RealtimeStatus status = {};
+    status.running = _running;
+    status.fifo = _fifo;
+    status.pinned = _pinned;
+    status.locked = _locked;
+    status.wakeups = _wakeups.load(std::memory_order_relaxed);
+    status.average_lateness_ns = status.wakeups ? _total_lateness_ns.load(std::memory_order_relaxed) / status.wakeups : 0;
+    status.max_lateness_ns = _max_lateness_ns.load(std::memory_order_relaxed);
+    status.dropped = _dropped.load(std::memory_order_relaxed);
+    return status;
+}
+
+bool RealtimeWorker::_push(const OutputCommand& command)
+{
+    if (_queue.tryPush(command)) {
+        return true;
+    }
+
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    logger().error("Realtime worker queue is full, dropping command for slot {}", command.slot);
+    return false;
+}
+
+void RealtimeWorker::_apply(const OutputCommand& command)
+{
+    if (command.slot >= _slot_count) {
+        return;
+    }
+
+    switch (command.type) {
+    case OutputCommand::Type::FAN_DUTY:
+        _slots[command.slot].duty = command.duty;
+        break;
+    }
+}
+
+void RealtimeWorker::_drain()
+{
+    OutputCommand command = {};
+    while (_queue.tryPop(command)) {
+        _apply(command);
+    }
+}
+
+void RealtimeWorker::_showFrames()
+{
+    for (size_t i = 0; i < _slot_count; ++i) {
+        FrameBuffer& buffer = _frames[i];
+        if (!(buffer.middle.load(std::memory_order_acquire) & FRESH_FRAME)) {
+            continue;
+        }
+
+        buffer.front = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel) & FRAME_INDEX;
+        LEDFrame& frame = buffer.frames[buffer.front];
+        frame.chain.show(*_slots[i].backend, frame.brightness);
+    }
+}
+
+void RealtimeWorker::_run()
+{
+    if (_lock_memory) {
+        prefaultStack();
+    }
+
+    uint64_t period_start = monotonicNow();
+    while (_running.load(std::memory_order_acquire)) {
+        _drain();
+        _showFrames();
+
+        // Rising edge: every fan with a non-zero duty starts the period on.
+        for (size_t i = 0; i < _slot_count; ++i) {
+            _setFan(_slots[i], _slots[i].duty > 0);
+        }
+
+        // Falling edges, in order of duty, for the fans that are only on for part of the period.
+        uint8_t previous_duty = 0;
+        for (;;) {
+            uint8_t next_duty = MAX_DUTY;
+            for (size_t i = 0; i < _slot_count; ++i) {
+                if (_slots[i].duty > previous_duty && _slots[i].duty < next_duty) {
+                    next_duty = _slots[i].duty;
+                }
+            }
+            if (next_duty == MAX_DUTY) {
+                break;
+            }
+
+            _sleepUntil(period_start + _period_ns * next_duty / MAX_DUTY);
+            for (size_t i = 0; i < _slot_count; ++i) {
+                if (_slots[i].duty == next_duty) {
+                    _setFan(_slots[i], false);
+                }
+            }
+            previous_duty = next_duty;
+        }
+
+        period_start += _period_ns;
+        uint64_t now = monotonicNow();
+        if (now > period_start + _period_ns) {
+            // Too far behind to catch up (for example, after a suspend); start a fresh period rather than running a burst of short ones.
+            period_start = now;
+        }
+        _sleepUntil(period_start);
+    }
+
+    // Apply anything sent during shutdown, such as turning the fans and LEDs off, and leave the lines in their final state.
+    _drain();
+    _showFrames();
+    for (size_t i = 0; i < _slot_count; ++i) {
+        _setFan(_slots[i], _slots[i].duty > 0);
+    }
+}
+
+void RealtimeWorker::_setFan(Slot& slot, bool high)
+{
+    if (slot.high == high) {
+        return;
+    }
+
+    slot.backend->write(Line::FAN, high ? HIGH : LOW);
+    slot.high = high;
+}
+
+void RealtimeWorker::_sleepUntil(uint64_t deadline_ns)
+{
+    timespec deadline = {};
+    deadline.tv_sec = static_cast<time_t>(deadline_ns / NANOSECONDS_PER_SECOND);
+    deadline.tv_nsec = static_cast<long>(deadline_ns % NANOSECONDS_PER_SECOND);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+    }
+
+    uint64_t lateness = monotonicNow() - deadline_ns;
+    if (static_cast<int64_t>(lateness) < 0) {
+        lateness = 0;
+    }
+
+    _wakeups.fetch_add(1, std::memory_order_relaxed);
+    _total_lateness_ns.fetch_add(lateness, std::memory_order_relaxed);
+    if (lateness > _max_lateness_ns.load(std::memory_order_relaxed)) {
+        _max_lateness_ns.store(lateness, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "fanshim/backend.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/gpio.hpp"
+#include "fanshim/spsc_queue.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+
+inline constexpr size_t REALTIME_QUEUE_SIZE = 256;
+
+struct OutputCommand
+{
+    enum class Type : uint8_t
+    {
+        FAN_DUTY
+    };
+
+    Type type;
+    uint8_t slot;
+    uint8_t duty;
+};
+
+struct RealtimeStatus
+{
+    bool running;
+    bool fifo;
+    bool pinned;
+    bool locked;
+    uint64_t wakeups;
+    uint64_t average_lateness_ns;
+    uint64_t max_lateness_ns;
+    uint64_t dropped;
+};
+
+/**
+ * A worker thread that owns the fan and LED output lines of every attached channel, so that software PWM and LED bit-banging are not delayed by the event
+ * loop.
+ *
+ * The event loop sends fan duty cycles over a single-producer, single-consumer queue, and hands over each LED frame whole through a triple buffer per
+ * slot, so a chain of any length costs one exchange and the worker never shows a partly written frame; both are applied at the start of each PWM period.
+ * The worker asks for SCHED_FIFO at the configured priority, CPU affinity and locked memory, and runs at normal priority if any of them is denied,
+ * measuring how late it wakes up either way.
+ */
+class RealtimeWorker
+{
+public:
+    RealtimeWorker(uint8_t priority, int32_t cpu, bool lock_memory, uint32_t pwm_frequency);
+    ~RealtimeWorker();
+
+    /**
+     * Hands a channel's output lines, with a chain of `led_count` LEDs, to the worker and returns the slot to address them with. Must be called before
+     * start().
+     */
+    uint8_t attach(GPIOBackend& backend, size_t led_count = 1);
+
+    void start();
+    void stop();
+
+    /**
+     * Called from the event loop. Returns false if the queue is full and the command was dropped.
+     */
+    bool setDuty(uint8_t slot, uint8_t duty);
+
+    /**
+     * Called from the event loop with the slot's chain, which must have the length given to attach(). Frames written faster than the worker shows them
+     * replace each other, so only the latest is shown.
+     */
+    void writeFrame(uint8_t slot, uint8_t brightness, const APA102Chain& chain);
+
+    RealtimeStatus status() const;
+
+private:
+    RealtimeWorker(const RealtimeWorker&) = delete;
+    RealtimeWorker(RealtimeWorker&&) = delete;
+    RealtimeWorker& operator=(const RealtimeWorker&) = delete;
+    RealtimeWorker& operator=(RealtimeWorker&&) = delete;
+
+    struct Slot
+    {
+        GPIOBackend* backend;
+        uint8_t duty;
+        bool high;
+    };
+
+    struct LEDFrame
+    {
+        APA102Chain chain = APA102Chain();
+        uint8_t brightness = 0;
+    };
+
+    /**
+     * The event loop writes into `back` and the worker shows `front`; publishing a frame or taking the latest one swaps with `middle`, whose FRESH_FRAME
+     * bit says whether it holds a frame the worker has not shown.
+     */
+    struct FrameBuffer
+    {
+        std::array<LEDFrame, 3> frames = {};
+        uint8_t back = 0;
+        uint8_t front = 1;
+        std::atomic<uint8_t> middle = 2;
+    };
+
+    bool _push(const OutputCommand& command);
+    void _apply(const OutputCommand& command);
+    void _drain();
+    void _showFrames();
+    void _run();
+    void _setFan(Slot& slot, bool high);
+    void _sleepUntil(uint64_t deadline_ns);
+
+    uint8_t _priority;
+    int32_t _cpu;
+    bool _lock_memory;
+    uint64_t _period_ns;
+    std::array<Slot, MAX_CHANNELS> _slots;
+    std::array<FrameBuffer, MAX_CHANNELS> _frames;
+    size_t _slot_count;
+    SPSCQueue<OutputCommand, REALTIME_QUEUE_SIZE> _queue;
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::atomic<bool> _fifo;
+    std::atomic<bool> _pinned;
+    std::atomic<bool> _locked;
+    std::atomic<uint64_t> _wakeups;
+    std::atomic<uint64_t> _total_lateness_ns;
+    std::atomic<uint64_t> _max_lateness_ns;
+    std::atomic<uint64_t> _dropped;
+};
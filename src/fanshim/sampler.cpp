@@ -0,0 +1,422 @@
+#include "fanshim/sampler.hpp"
+
+#include "fanshim/attribute.hpp"
+#include "fanshim/logger.hpp"
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+
+inline constexpr int32_t NO_SLOT = -1;
+
+
+// There is no liburing dependency; the three io_uring system calls are made directly.
+static int32_t ioUringSetup(uint32_t entries, io_uring_params& parameters)
+{
+    return static_cast<int32_t>(::syscall(__NR_io_uring_setup, entries, &parameters));
+}
+
+static int32_t ioUringEnter(int32_t ring_fd, uint32_t submit)
+{
+    return static_cast<int32_t>(::syscall(__NR_io_uring_enter, ring_fd, submit, 0, 0, nullptr, 0));
+}
+
+static int32_t ioUringRegister(int32_t ring_fd, uint32_t opcode, const void* arguments, uint32_t count)
+{
+    return static_cast<int32_t>(::syscall(__NR_io_uring_register, ring_fd, opcode, arguments, count));
+}
+
+static void* mapRing(int32_t ring_fd, size_t size, off_t offset)
+{
+    return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+}
+
+template <typename T>
+static T* ringField(void* ring, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+
+AttributeSampler::AttributeSampler(uv_loop_t* loop, bool use_io_uring)
+    : _loop(loop),
+      _use_io_uring(use_io_uring),
+      _prepared(false),
+      _inputs(),
+      _callback(),
+      _on_closed(),
+      _ring_fd(NO_FD),
+      _event_fd(NO_FD),
+      _poll_handle(),
+      _polling(false),
+      _sq_ring(MAP_FAILED),
+      _sq_ring_size(0),
+      _cq_ring(MAP_FAILED),
+      _cq_ring_size(0),
+      _sqes(nullptr),
+      _sqes_size(0),
+      _sq_head(nullptr),
+      _sq_tail(nullptr),
+      _sq_mask(0),
+      _sq_array(nullptr),
+      _cq_head(nullptr),
+      _cq_tail(nullptr),
+      _cq_mask(0),
+      _cqes(nullptr),
+      _pending(0),
+      _registered(0),
+      _batches(0),
+      _overruns(0),
+      _failures(0)
+{}
+
+AttributeSampler::~AttributeSampler()
+{
+    assert(!_polling && "AttributeSampler::close() must complete before the sampler is destroyed");
+    if (_polling && !uv_is_closing(reinterpret_cast<uv_handle_t*>(&_poll_handle))) {
+        // Closing the handle here would call back into the destroyed sampler, so it is only stopped.
+        logger().critical("Sampler destroyed before close() completed, its poll handle is still linked into the loop");
+        uv_poll_stop(&_poll_handle);
+        _polling = false;
+    }
+    _closeRing();
+    for (auto& input : _inputs) {
+        closeAttribute(input.fd);
+    }
+}
+
+size_t AttributeSampler::add(const std::filesystem::path& path)
+{
+    _inputs.push_back({path, openAttribute(path), NO_SLOT, {}, {}, 0, false});
+    return _inputs.size() - 1;
+}
+
+void AttributeSampler::onComplete(Callback callback)
+{
+    _callback = std::move(callback);
+}
+
+bool AttributeSampler::submit()
+{
+    if (_pending > 0) {
+        _overruns++;
+        return false;
+    }
+
+    if (!_prepared) {
+        _prepared = true;
+        if (_use_io_uring) {
+            _setupRing();
+        }
+        logger().warn("Sampling {} input(s) with {}", _inputs.size(), usingIoUring() ? "io_uring" : "pread");
+    }
+
+    // Sensors such as hwmon inputs may appear after the driver starts, so a missing one is retried on every batch. One opened late is not in the registered
+    // file table and is read through its descriptor instead.
+    for (auto& input : _inputs) {
+        if (input.fd < 0) {
+            input.fd = openAttribute(input.path);
+        }
+    }
+
+    _batches++;
+    if (usingIoUring() && _submitRing()) {
+        return true;
+    }
+
+    _readAll();
+    _complete();
+    return true;
+}
+
+bool AttributeSampler::value(size_t index, int64_t& value) const
+{
+    const Input& input = _inputs[index];
+    if (!input.valid) {
+        return false;
+    }
+
+    value = input.value;
+    return true;
+}
+
+const std::filesystem::path& AttributeSampler::path(size_t index) const
+{
+    return _inputs[index].path;
+}
+
+bool AttributeSampler::usingIoUring() const
+{
+    return _ring_fd >= 0;
+}
+
+SamplerStats AttributeSampler::stats() const
+{
+    SamplerStats stats = {};
+    stats.io_uring = usingIoUring();
+    stats.inputs = _inputs.size();
+    stats.registered = _registered;
+    stats.batches = _batches;
+    stats.overruns = _overruns;
+    stats.failures = _failures;
+    return stats;
+}
+
+void AttributeSampler::close(Callback callback)
+{
+    _callback = nullptr;
+    _on_closed = std::move(callback);
+    _closeRing();
+    if (!_polling && _on_closed) {
+        Callback on_closed = std::move(_on_closed);
+        on_closed();
+    }
+}
+
+void AttributeSampler::_onPoll(uv_poll_t* handle, int32_t status, int32_t events)
+{
+    AttributeSampler* self = static_cast<AttributeSampler*>(handle->data);
+    if (status < 0) {
+        // A batch in flight is abandoned with the ring and read again with pread(), as every later one is.
+        self->_failures++;
+        logger().error("Polling the io_uring eventfd failed, sampling with pread: {}", uv_strerror(status));
+        bool in_flight = self->_pending > 0;
+        self->_closeRing();
+        if (in_flight) {
+            self->_readAll();
+            self->_complete();
+        }
+        return;
+    }
+
+    // Clears the eventfd; every completion posted so far is reaped below, however many times it was signalled.
+    uint64_t count = 0;
+    while (::read(self->_event_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+    self->_reap();
+}
+
+bool AttributeSampler::_setupRing()
+{
+    io_uring_params parameters = {};
+    _ring_fd = ioUringSetup(static_cast<uint32_t>(std::max<size_t>(_inputs.size(), 1)), parameters);
+    if (_ring_fd < 0) {
+        logger().warn("io_uring is unavailable, sampling with pread: {}", strerror(errno));
+        _ring_fd = NO_FD;
+        return false;
+    }
+
+    // The rings are mapped separately even on kernels that share one mapping between them; the kernel hands back the same pages for both offsets.
+    _sq_ring_size = parameters.sq_off.array + parameters.sq_entries * sizeof(uint32_t);
+    _cq_ring_size = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+    _sqes_size = parameters.sq_entries * sizeof(io_uring_sqe);
+    _sq_ring = mapRing(_ring_fd, _sq_ring_size, IORING_OFF_SQ_RING);
+    _cq_ring = mapRing(_ring_fd, _cq_ring_size, IORING_OFF_CQ_RING);
+    void* sqes = mapRing(_ring_fd, _sqes_size, IORING_OFF_SQES);
+    _sqes = sqes != MAP_FAILED ? static_cast<io_uring_sqe*>(sqes) : nullptr;
+    if (_sq_ring == MAP_FAILED || _cq_ring == MAP_FAILED || !_sqes) {
+        logger().warn("Failed to map the io_uring rings, sampling with pread: {}", strerror(errno));
+        _closeRing();
+        return false;
+    }
+
+    _sq_head = ringField<uint32_t>(_sq_ring, parameters.sq_off.head);
+    _sq_tail = ringField<uint32_t>(_sq_ring, parameters.sq_off.tail);
+    _sq_mask = *ringField<uint32_t>(_sq_ring, parameters.sq_off.ring_mask);
+    _sq_array = ringField<uint32_t>(_sq_ring, parameters.sq_off.array);
+    _cq_head = ringField<uint32_t>(_cq_ring, parameters.cq_off.head);
+    _cq_tail = ringField<uint32_t>(_cq_ring, parameters.cq_off.tail);
+    _cq_mask = *ringField<uint32_t>(_cq_ring, parameters.cq_off.ring_mask);
+    _cqes = ringField<io_uring_cqe>(_cq_ring, parameters.cq_off.cqes);
+
+    // Registered files save the kernel a descriptor table lookup and reference count on every read.
+    std::vector<int32_t> fds;
+    for (auto& input : _inputs) {
+        if (input.fd >= 0) {
+            input.slot = static_cast<int32_t>(fds.size());
+            fds.push_back(input.fd);
+        }
+    }
+    if (!fds.empty()) {
+        if (ioUringRegister(_ring_fd, IORING_REGISTER_FILES, fds.data(), static_cast<uint32_t>(fds.size())) == 0) {
+            _registered = fds.size();
+        }
+        else {
+            logger().warn("Failed to register sampler inputs with io_uring, reading them by descriptor: {}", strerror(errno));
+            for (auto& input : _inputs) {
+                input.slot = NO_SLOT;
+            }
+        }
+    }
+
+    _event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd < 0 || ioUringRegister(_ring_fd, IORING_REGISTER_EVENTFD, &_event_fd, 1) != 0) {
+        logger().warn("Failed to attach an eventfd to io_uring, sampling with pread: {}", strerror(errno));
+        _closeRing();
+        return false;
+    }
+
+    int32_t result = uv_poll_init(_loop, &_poll_handle, _event_fd);
+    if (result == 0) {
+        _polling = true;
+        _poll_handle.data = this;
+        result = uv_poll_start(&_poll_handle, UV_READABLE, _onPoll);
+        // The poll only holds the loop open while a batch is in flight, so an idle sampler does not keep a stopped driver's loop running.
+        uv_unref(reinterpret_cast<uv_handle_t*>(&_poll_handle));
+    }
+    if (result) {
+        logger().warn("Failed to poll the io_uring eventfd, sampling with pread: {}", uv_strerror(result));
+        _closeRing();
+        return false;
+    }
+
+    return true;
+}
+
+void AttributeSampler::_onPollClosed(uv_handle_t* handle)
+{
+    AttributeSampler* self = static_cast<AttributeSampler*>(handle->data);
+    self->_polling = false;
+
+    // Moved out first, as the callback may destroy the sampler.
+    if (self->_on_closed) {
+        Callback on_closed = std::move(self->_on_closed);
+        on_closed();
+    }
+}
+
+void AttributeSampler::_closeRing()
+{
+    // Closing the handle also stops it; _polling stays set until the loop has unlinked it.
+    if (_polling && !uv_is_closing(reinterpret_cast<uv_handle_t*>(&_poll_handle))) {
+        uv_close(reinterpret_cast<uv_handle_t*>(&_poll_handle), _onPollClosed);
+    }
+
+    if (_sqes) {
+        ::munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_cq_ring != MAP_FAILED) {
+        ::munmap(_cq_ring, _cq_ring_size);
+        _cq_ring = MAP_FAILED;
+    }
+    if (_sq_ring != MAP_FAILED) {
+        ::munmap(_sq_ring, _sq_ring_size);
+        _sq_ring = MAP_FAILED;
+    }
+
+    // Closing the ring also drops the registered files and eventfd, and cancels anything in flight.
+    closeAttribute(_event_fd);
+    closeAttribute(_ring_fd);
+    for (auto& input : _inputs) {
+        input.slot = NO_SLOT;
+    }
+    _registered = 0;
+    _pending = 0;
+}
+
+bool AttributeSampler::_submitRing()
+{
+    // Only this thread produces submissions, so the tail is read plainly; the release store publishes the entries to the kernel.
+    uint32_t tail = *_sq_tail;
+    uint32_t queued = 0;
+    for (size_t i = 0; i < _inputs.size(); ++i) {
+        Input& input = _inputs[i];
+        input.valid = false;
+        if (input.fd < 0) {
+            continue;
+        }
+
+        uint32_t index = tail & _sq_mask;
+        io_uring_sqe& sqe = _sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        input.iov.iov_base = input.buffer.data();
+        input.iov.iov_len = input.buffer.size() - 1;
+        sqe.opcode = IORING_OP_READV;
+        sqe.flags = input.slot != NO_SLOT ? IOSQE_FIXED_FILE : 0;
+        sqe.fd = input.slot != NO_SLOT ? input.slot : input.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(&input.iov);
+        sqe.len = 1;
+        sqe.off = 0;
+        sqe.user_data = i;
+        _sq_array[index] = index;
+        tail++;
+        queued++;
+    }
+    if (queued == 0) {
+        return false;
+    }
+
+    __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+    _pending = queued;
+    while (queued > 0) {
+        int32_t submitted = ioUringEnter(_ring_fd, queued);
+        if (submitted < 0 && errno == EINTR) {
+            continue;
+        }
+        if (submitted <= 0) {
+            _failures++;
+            logger().error("io_uring submission failed, sampling with pread: {}", strerror(submitted < 0 ? errno : EBUSY));
+            _closeRing();
+            return false;
+        }
+        queued -= submitted;
+    }
+
+    uv_ref(reinterpret_cast<uv_handle_t*>(&_poll_handle));
+    return true;
+}
+
+void AttributeSampler::_readAll()
+{
+    for (auto& input : _inputs) {
+        input.valid = input.fd >= 0 && readAttribute(input.fd, input.value);
+    }
+}
+
+void AttributeSampler::_reap()
+{
+    bool reaped = false;
+    uint32_t head = *_cq_head;
+    uint32_t tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+        if (cqe.user_data >= _inputs.size()) {
+            continue;
+        }
+
+        Input& input = _inputs[cqe.user_data];
+        if (cqe.res > 0) {
+            input.buffer[cqe.res] = '\0';
+            input.valid = parseAttribute(input.buffer.data(), input.value);
+        }
+        if (_pending > 0) {
+            _pending--;
+        }
+        reaped = true;
+    }
+    __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+
+    if (reaped && _pending == 0) {
+        uv_unref(reinterpret_cast<uv_handle_t*>(&_poll_handle));
+        _complete();
+    }
+}
+
+void AttributeSampler::_complete()
+{
+    if (_callback) {
+        _callback();
+    }
+}
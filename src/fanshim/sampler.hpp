@@ -0,0 +1,133 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <uv.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+
+inline constexpr size_t SAMPLE_BUFFER_SIZE = 32;
+
+struct SamplerStats
+{
+    bool io_uring;
+    size_t inputs;
+    size_t registered;
+    uint64_t batches;
+    uint64_t overruns;
+    uint64_t failures;
+};
+
+/**
+ * Reads a set of integer procfs and sysfs attributes together, once per tick.
+ *
+ * With io_uring, every input is opened once and registered with the ring, and a tick queues one read per input and submits them with a single system call.
+ * The ring signals an eventfd that the libuv loop polls, so the batch completes on the loop without blocking it. Where io_uring is unavailable (older
+ * kernels, or disabled by seccomp or sysctl) each input is read with pread() and the batch completes before submit() returns.
+ *
+ * The poll handle is linked into the loop until it is closed, so the sampler must be closed, and its close callback reached, before it is destroyed.
+ */
+class AttributeSampler
+{
+public:
+    using Callback = std::function<void()>;
+
+    AttributeSampler(uv_loop_t* loop, bool use_io_uring);
+    ~AttributeSampler();
+
+    /**
+     * Opens `path` and adds it to every batch, returning the index to read its value with. Must be called before the first submit().
+     */
+    size_t add(const std::filesystem::path& path);
+
+    /**
+     * Called on the loop once every input of a batch has been read.
+     */
+    void onComplete(Callback callback);
+
+    /**
+     * Starts a batch. Returns false, skipping the tick, if the previous batch is still in flight.
+     */
+    bool submit();
+
+    /**
+     * The input's value from the last completed batch. Returns false if it could not be read or parsed.
+     */
+    bool value(size_t index, int64_t& value) const;
+    const std::filesystem::path& path(size_t index) const;
+
+    bool usingIoUring() const;
+    SamplerStats stats() const;
+
+    /**
+     * Closes the ring and its poll handle, calling `callback` on the loop once the handle is closed, or immediately if there is none. The sampler may be
+     * destroyed from the callback.
+     */
+    void close(Callback callback);
+
+private:
+    AttributeSampler(const AttributeSampler&) = delete;
+    AttributeSampler(AttributeSampler&&) = delete;
+    AttributeSampler& operator=(const AttributeSampler&) = delete;
+    AttributeSampler& operator=(AttributeSampler&&) = delete;
+
+    struct Input
+    {
+        std::filesystem::path path;
+        int32_t fd;
+        int32_t slot;
+        iovec iov;
+        std::array<char, SAMPLE_BUFFER_SIZE> buffer;
+        int64_t value;
+        bool valid;
+    };
+
+    static void _onPoll(uv_poll_t* handle, int32_t status, int32_t events);
+    static void _onPollClosed(uv_handle_t* handle);
+
+    /**
+     * Creates the ring, registers the open inputs and the eventfd, and starts polling. Returns false, leaving the sampler on pread(), if any step fails.
+     */
+    bool _setupRing();
+    void _closeRing();
+    bool _submitRing();
+    void _readAll();
+    void _reap();
+    void _complete();
+
+    uv_loop_t* _loop;
+    bool _use_io_uring;
+    bool _prepared;
+    std::vector<Input> _inputs;
+    Callback _callback;
+    Callback _on_closed;
+    int32_t _ring_fd;
+    int32_t _event_fd;
+    uv_poll_t _poll_handle;
+    bool _polling;
+    void* _sq_ring;
+    size_t _sq_ring_size;
+    void* _cq_ring;
+    size_t _cq_ring_size;
+    io_uring_sqe* _sqes;
+    size_t _sqes_size;
+    uint32_t* _sq_head;
+    uint32_t* _sq_tail;
+    uint32_t _sq_mask;
+    uint32_t* _sq_array;
+    uint32_t* _cq_head;
+    uint32_t* _cq_tail;
+    uint32_t _cq_mask;
+    io_uring_cqe* _cqes;
+    size_t _pending;
+    size_t _registered;
+    uint64_t _batches;
+    uint64_t _overruns;
+    uint64_t _failures;
+};
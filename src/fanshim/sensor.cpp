@@ -0,0 +1,69 @@
+#include "fanshim/sensor.hpp"
+
+#include "fanshim/attribute.hpp"
+#include "fanshim/logger.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+
+double readTemperature(const std::filesystem::path& sensor)
+{
+    int32_t fd = openAttribute(sensor);
+    if (fd < 0) {
+        return NO_TEMPERATURE;
+    }
+
+    double temperature = readTemperature(fd, sensor);
+    closeAttribute(fd);
+    return temperature;
+}
+
+double readTemperature(int32_t fd, const std::filesystem::path& sensor)
+{
+    int64_t millidegrees = 0;
+    if (!readAttribute(fd, millidegrees)) {
+        logger().error("Failed to convert temperature from {}", sensor.native());
+        return NO_TEMPERATURE;
+    }
+    return millidegrees / 1000.0;
+}
+
+FileTemperatureSource::FileTemperatureSource(const std::filesystem::path& sensor) : _sensor(sensor), _fd(openAttribute(sensor))
+{}
+
+FileTemperatureSource::~FileTemperatureSource()
+{
+    closeAttribute(_fd);
+}
+
+std::unique_ptr<TemperatureSource> FileTemperatureSource::create(const ChannelConfiguration& configuration)
+{
+    return std::make_unique<FileTemperatureSource>(configuration.sensor);
+}
+
+double FileTemperatureSource::read()
+{
+    // Sensors such as hwmon inputs may appear after the driver starts, so a missing one is retried on every read.
+    if (_fd < 0) {
+        _fd = openAttribute(_sensor);
+        if (_fd < 0) {
+            return NO_TEMPERATURE;
+        }
+    }
+    return readTemperature(_fd, _sensor);
+}
+
+SampledTemperatureSource::SampledTemperatureSource(const AttributeSampler& sampler, size_t index) : _sampler(sampler), _index(index)
+{}
+
+double SampledTemperatureSource::read()
+{
+    int64_t millidegrees = 0;
+    if (!_sampler.value(_index, millidegrees)) {
+        logger().error("Failed to convert temperature from {}", _sampler.path(_index).native());
+        return NO_TEMPERATURE;
+    }
+    return millidegrees / 1000.0;
+}
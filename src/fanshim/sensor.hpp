@@ -0,0 +1,79 @@
+#pragma once
+
+#include "fanshim/configuration.hpp"
+#include "fanshim/sampler.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+
+
+inline constexpr double NO_TEMPERATURE = std::numeric_limits<double>::quiet_NaN();
+
+/**
+ * Reads a temperature, in degrees celsius, from a file containing millidegrees (such as a thermal zone or hwmon input).
+ *
+ * Returns NO_TEMPERATURE if the file cannot be read or parsed.
+ */
+double readTemperature(const std::filesystem::path& sensor);
+
+/**
+ * As above, from a sensor already opened with openAttribute(). `sensor` is only used for logging.
+ */
+double readTemperature(int32_t fd, const std::filesystem::path& sensor);
+
+/**
+ * Where a channel reads its temperature from.
+ */
+class TemperatureSource
+{
+public:
+    using Factory = std::function<std::unique_ptr<TemperatureSource>(const ChannelConfiguration& configuration)>;
+
+    virtual ~TemperatureSource() = default;
+
+    /**
+     * Returns the current temperature in degrees celsius, or NO_TEMPERATURE if it could not be read.
+     */
+    virtual double read() = 0;
+};
+
+/**
+ * Reads the sensor file named by the channel configuration, keeping it open between reads.
+ */
+class FileTemperatureSource : public TemperatureSource
+{
+public:
+    FileTemperatureSource(const std::filesystem::path& sensor);
+    ~FileTemperatureSource() override;
+
+    static std::unique_ptr<TemperatureSource> create(const ChannelConfiguration& configuration);
+
+    double read() override;
+
+private:
+    FileTemperatureSource(const FileTemperatureSource&) = delete;
+    FileTemperatureSource(FileTemperatureSource&&) = delete;
+    FileTemperatureSource& operator=(const FileTemperatureSource&) = delete;
+    FileTemperatureSource& operator=(FileTemperatureSource&&) = delete;
+
+    std::filesystem::path _sensor;
+    int32_t _fd;
+};
+
+/**
+ * Returns the channel's sensor value from the driver's last sampler batch, for sensors read together rather than one at a time.
+ */
+class SampledTemperatureSource : public TemperatureSource
+{
+public:
+    SampledTemperatureSource(const AttributeSampler& sampler, size_t index);
+
+    double read() override;
+
+private:
+    const AttributeSampler& _sampler;
+    size_t _index;
+};
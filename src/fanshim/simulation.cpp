@@ -0,0 +1,122 @@
+#include "fanshim/simulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+double ScriptedTemperature::read()
+{
+    return temperature();
+}
+
+static bool parseRow(std::string line, TracePoint& point)
+{
+    for (char& character : line) {
+        if (character == ',') {
+            character = ' ';
+        }
+    }
+
+    std::istringstream stream(line);
+    double seconds = 0;
+    if (!(stream >> seconds)) {
+        return false;
+    }
+
+    point.time = std::chrono::milliseconds(static_cast<int64_t>(std::llround(seconds * 1000)));
+    point.temperatures.clear();
+
+    double temperature = 0;
+    while (stream >> temperature) {
+        point.temperatures.push_back(temperature);
+    }
+    return !point.temperatures.empty() && stream.eof();
+}
+
+Trace loadTrace(const std::filesystem::path& trace_file)
+{
+    std::ifstream stream(trace_file, std::ios::in);
+    if (!stream) {
+        throw std::runtime_error("Failed to open trace " + trace_file.native());
+    }
+
+    Trace trace;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(stream, line)) {
+        line_number++;
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+
+        TracePoint point = {};
+        if (!parseRow(line, point)) {
+            if (trace.empty() && line_number == 1) {
+                continue;
+            }
+            throw std::runtime_error("Invalid trace row at " + trace_file.native() + ":" + std::to_string(line_number));
+        }
+
+        if (!trace.empty() && point.time < trace.back().time) {
+            throw std::runtime_error("Trace rows are out of order at " + trace_file.native() + ":" + std::to_string(line_number));
+        }
+        trace.push_back(std::move(point));
+    }
+
+    if (trace.empty()) {
+        throw std::runtime_error("Trace " + trace_file.native() + " contains no rows");
+    }
+    return trace;
+}
+
+TraceTemperature::TraceTemperature(std::shared_ptr<const Trace> trace, size_t column)
+    : _trace(std::move(trace)), _column(column), _row(0), _time(_trace->front().time)
+{}
+
+double TraceTemperature::temperature() const
+{
+    auto column = [this](const TracePoint& point) { return point.temperatures[std::min(_column, point.temperatures.size() - 1)]; };
+
+    const TracePoint& current = (*_trace)[_row];
+    if (_row + 1 >= _trace->size() || _time <= current.time) {
+        return column(current);
+    }
+
+    const TracePoint& next = (*_trace)[_row + 1];
+    double fraction = std::chrono::duration<double>(_time - current.time) / std::chrono::duration<double>(next.time - current.time);
+    return column(current) + (column(next) - column(current)) * fraction;
+}
+
+void TraceTemperature::advance(std::chrono::milliseconds elapsed, bool /* unused */)
+{
+    _time += elapsed;
+    while (_row + 1 < _trace->size() && (*_trace)[_row + 1].time <= _time) {
+        _row++;
+    }
+}
+
+ThermalModel::ThermalModel(const ThermalParameters& parameters) : _parameters(parameters), _temperature(parameters.initial)
+{}
+
+double ThermalModel::temperature() const
+{
+    return _temperature;
+}
+
+void ThermalModel::advance(std::chrono::milliseconds elapsed, bool fan)
+{
+    double target = fan ? _parameters.fan_on : _parameters.fan_off;
+    double decay = std::exp(-std::chrono::duration<double>(elapsed) / std::chrono::duration<double>(_parameters.time_constant));
+    _temperature = target + (_temperature - target) * decay;
+}
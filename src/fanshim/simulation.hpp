@@ -0,0 +1,88 @@
+#pragma once
+
+#include "fanshim/sensor.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+
+inline constexpr double DEFAULT_MODEL_INITIAL = 40.0;
+inline constexpr double DEFAULT_MODEL_FAN_OFF = 70.0;
+inline constexpr double DEFAULT_MODEL_FAN_ON = 45.0;
+inline constexpr std::chrono::seconds DEFAULT_MODEL_TIME_CONSTANT = std::chrono::seconds(90);
+
+/**
+ * A simulated temperature, advanced by the simulation between driver wakeups with the fan state the driver left behind.
+ */
+class ScriptedTemperature : public TemperatureSource
+{
+public:
+    virtual double temperature() const = 0;
+    virtual void advance(std::chrono::milliseconds elapsed, bool fan) = 0;
+
+    double read() override;
+};
+
+/**
+ * One row of a recorded trace: a time offset and a temperature for each traced channel.
+ */
+struct TracePoint
+{
+    std::chrono::milliseconds time;
+    std::vector<double> temperatures;
+};
+
+using Trace = std::vector<TracePoint>;
+
+/**
+ * Loads a trace from a text file with one row per line: a time in seconds followed by one or more temperatures in degrees celsius, separated by commas or
+ * whitespace. Blank lines, lines starting with '#' and a leading header row are skipped. Rows must be in time order.
+ *
+ * Throws std::runtime_error if the file cannot be read or contains no rows.
+ */
+Trace loadTrace(const std::filesystem::path& trace_file);
+
+/**
+ * Replays one column of a recorded trace, interpolating linearly between rows and holding the last row once the trace ends. The fan state is ignored.
+ */
+class TraceTemperature : public ScriptedTemperature
+{
+public:
+    TraceTemperature(std::shared_ptr<const Trace> trace, size_t column);
+
+    double temperature() const override;
+    void advance(std::chrono::milliseconds elapsed, bool fan) override;
+
+private:
+    std::shared_ptr<const Trace> _trace;
+    size_t _column;
+    size_t _row;
+    std::chrono::milliseconds _time;
+};
+
+struct ThermalParameters
+{
+    double initial;
+    double fan_off;
+    double fan_on;
+    std::chrono::seconds time_constant;
+};
+
+/**
+ * A first-order thermal model: the temperature decays exponentially towards the steady state for the current fan state.
+ */
+class ThermalModel : public ScriptedTemperature
+{
+public:
+    ThermalModel(const ThermalParameters& parameters);
+
+    double temperature() const override;
+    void advance(std::chrono::milliseconds elapsed, bool fan) override;
+
+private:
+    ThermalParameters _parameters;
+    double _temperature;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+/**
+ * A bounded, lock-free queue for exactly one producer thread and one consumer thread.
+ *
+ * Capacity must be a power of two. Head and tail live on separate cache lines so that the two threads do not contend on them.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SPSCQueue capacity must be a power of two");
+
+public:
+    SPSCQueue() : _head(0), _tail(0), _items()
+    {}
+
+    /**
+     * Called by the producer. Returns false, leaving the queue unchanged, if it is full.
+     */
+    bool tryPush(const T& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+
+        _items[tail & (Capacity - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Called by the consumer. Returns false if the queue is empty.
+     */
+    bool tryPop(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        item = _items[head & (Capacity - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue(SPSCQueue&&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(SPSCQueue&&) = delete;
+
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail;
+    alignas(CACHE_LINE_SIZE) std::array<T, Capacity> _items;
+};
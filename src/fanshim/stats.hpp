@@ -0,0 +1,128 @@
+#pragma once
+
+#include <uv.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+struct TimerStats
+{
+    uint64_t runs;
+    uint64_t total_ns;
+    uint64_t max_ns;
+
+    uint64_t averageNs() const
+    {
+        return runs ? total_ns / runs : 0;
+    }
+
+    void record(uint64_t elapsed_ns)
+    {
+        runs++;
+        total_ns += elapsed_ns;
+        max_ns = std::max(max_ns, elapsed_ns);
+    }
+};
+
+class ScopedTimer
+{
+public:
+    ScopedTimer(TimerStats& stats) : _stats(stats), _start(uv_hrtime())
+    {}
+
+    ~ScopedTimer()
+    {
+        _stats.record(uv_hrtime() - _start);
+    }
+
+private:
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer(ScopedTimer&&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+    TimerStats& _stats;
+    uint64_t _start;
+};
+
+enum class StartupPhase : uint8_t
+{
+    LOGGER,
+    CONFIGURATION,
+    DRIVER,
+    TIMERS,
+    SERVE,
+    FIRST_CONTROL
+};
+
+inline constexpr size_t STARTUP_PHASE_COUNT = 6;
+
+/**
+ * When each phase of startup ended, measured from the first call to startupTimeline(). Phases that never run, such as serving when the driver is embedded,
+ * take no time.
+ */
+class StartupTimeline
+{
+public:
+    StartupTimeline() : _origin(uv_hrtime()), _ends()
+    {}
+
+    /**
+     * Records the end of `phase`. Only the first end of each phase is kept.
+     */
+    void mark(StartupPhase phase)
+    {
+        uint64_t& end = _ends[static_cast<size_t>(phase)];
+        if (end == 0) {
+            end = std::max<uint64_t>(uv_hrtime() - _origin, 1);
+        }
+    }
+
+    bool reached(StartupPhase phase) const
+    {
+        return _ends[static_cast<size_t>(phase)] > 0;
+    }
+
+    /**
+     * The time from the origin to the end of `phase`, or 0 if it has not ended.
+     */
+    uint64_t elapsedNs(StartupPhase phase) const
+    {
+        return _ends[static_cast<size_t>(phase)];
+    }
+
+    /**
+     * The time from the end of the last phase before `phase` that ran, or from the origin, to the end of `phase`.
+     */
+    uint64_t durationNs(StartupPhase phase) const
+    {
+        size_t index = static_cast<size_t>(phase);
+        if (_ends[index] == 0) {
+            return 0;
+        }
+
+        uint64_t start = 0;
+        for (size_t i = 0; i < index; ++i) {
+            if (_ends[i] > 0 && _ends[i] <= _ends[index]) {
+                start = std::max(start, _ends[i]);
+            }
+        }
+        return _ends[index] - start;
+    }
+
+private:
+    uint64_t _origin;
+    std::array<uint64_t, STARTUP_PHASE_COUNT> _ends;
+};
+
+/**
+ * The process's startup timeline. Call it as early as possible to start the clock.
+ */
+inline StartupTimeline& startupTimeline()
+{
+    static StartupTimeline timeline;
+    return timeline;
+}
@@ -0,0 +1,190 @@
+#include "fanshim/throttle.hpp"
+
+#include "fanshim/attribute.hpp"
+#include "fanshim/logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+
+inline constexpr std::string_view CPU_DIRECTORY = "devices/system/cpu";
+inline constexpr std::string_view TRIP_POINT_PREFIX = "trip_point_";
+inline constexpr std::string_view TRIP_POINT_TYPE_SUFFIX = "_type";
+inline constexpr std::string_view TRIP_POINT_TEMP_SUFFIX = "_temp";
+
+
+static bool isCPUDirectory(const std::string& name)
+{
+    return name.size() > 3 && name.compare(0, 3, "cpu") == 0 && std::all_of(name.begin() + 3, name.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+double readTripPoint(const std::filesystem::path& sensor)
+{
+    std::error_code ec;
+    std::filesystem::path zone = sensor.parent_path();
+    double lowest = 0.0;
+
+    for (const auto& entry : std::filesystem::directory_iterator(zone, ec)) {
+        std::string name = entry.path().filename().native();
+        if (name.compare(0, TRIP_POINT_PREFIX.size(), TRIP_POINT_PREFIX) != 0 || name.size() <= TRIP_POINT_TYPE_SUFFIX.size() ||
+            name.compare(name.size() - TRIP_POINT_TYPE_SUFFIX.size(), TRIP_POINT_TYPE_SUFFIX.size(), TRIP_POINT_TYPE_SUFFIX) != 0) {
+            continue;
+        }
+
+        // Active trip points belong to cooling devices such as this fan; only the others indicate that the SoC is about to protect itself.
+        std::string type;
+        std::ifstream(entry.path()) >> type;
+        if (type != "passive" && type != "hot" && type != "critical") {
+            continue;
+        }
+
+        std::string temperature_file = name.substr(0, name.size() - TRIP_POINT_TYPE_SUFFIX.size()) + std::string(TRIP_POINT_TEMP_SUFFIX);
+        int64_t millidegrees = 0;
+        if (!(std::ifstream(zone / temperature_file) >> millidegrees) || millidegrees <= 0) {
+            continue;
+        }
+
+        double trip = millidegrees / 1000.0;
+        lowest = lowest == 0.0 ? trip : std::min(lowest, trip);
+    }
+
+    return lowest;
+}
+
+ThrottleMonitor::ThrottleMonitor(const std::filesystem::path& sys_root)
+    : _sys_root(sys_root),
+      _cpus(),
+      _frequency_ratio(1.0),
+      _last_sample(0),
+      _throttled_time(0),
+      _throttle_events(0),
+      _throttled(false)
+{}
+
+ThrottleMonitor::~ThrottleMonitor()
+{
+    close();
+}
+
+bool ThrottleMonitor::open()
+{
+    close();
+
+    std::error_code ec;
+    std::vector<std::filesystem::path> directories;
+    for (const auto& entry : std::filesystem::directory_iterator(_sys_root / CPU_DIRECTORY, ec)) {
+        if (isCPUDirectory(entry.path().filename().native()) && std::filesystem::exists(entry.path() / "cpufreq" / "cpuinfo_max_freq", ec)) {
+            directories.push_back(entry.path() / "cpufreq");
+        }
+    }
+    std::sort(directories.begin(), directories.end());
+
+    for (const auto& directory : directories) {
+        CPU cpu = {NO_FD, NO_FD, 0, 0};
+        int32_t maximum_fd = openAttribute(directory / "cpuinfo_max_freq");
+        bool has_maximum = maximum_fd >= 0 && readAttribute(maximum_fd, cpu.maximum) && cpu.maximum > 0;
+        closeAttribute(maximum_fd);
+
+        cpu.current_fd = openAttribute(directory / "scaling_cur_freq");
+        cpu.limit_fd = openAttribute(directory / "scaling_max_freq");
+        if (!has_maximum || cpu.current_fd < 0 || cpu.limit_fd < 0 || !readAttribute(cpu.limit_fd, cpu.baseline) || cpu.baseline == 0) {
+            closeAttribute(cpu.current_fd);
+            closeAttribute(cpu.limit_fd);
+            continue;
+        }
+        if (cpu.baseline < cpu.maximum) {
+            logger().warn("{} is capped at {} kHz of {} kHz, throttling is measured against the cap", directory.parent_path().filename().native(), cpu.baseline, cpu.maximum);
+        }
+        _cpus.push_back(cpu);
+    }
+
+    if (_cpus.empty()) {
+        logger().warn("No cpufreq CPUs found under {}, throttling will not be detected", _sys_root.native());
+        return false;
+    }
+
+    logger().warn("Monitoring throttling across {} CPU(s)", _cpus.size());
+    return true;
+}
+
+void ThrottleMonitor::close()
+{
+    for (auto& cpu : _cpus) {
+        closeAttribute(cpu.current_fd);
+        closeAttribute(cpu.limit_fd);
+    }
+    _cpus.clear();
+}
+
+bool ThrottleMonitor::isOpen() const
+{
+    return !_cpus.empty();
+}
+
+bool ThrottleMonitor::sample(std::chrono::milliseconds now, bool near_trip)
+{
+    if (_throttled && now > _last_sample) {
+        _throttled_time += now - _last_sample;
+    }
+    _last_sample = now;
+
+    bool throttled = false;
+    double frequency_ratio = 1.0;
+    for (auto& cpu : _cpus) {
+        uint64_t current = 0;
+        uint64_t limit = 0;
+        if (!readAttribute(cpu.current_fd, current) || !readAttribute(cpu.limit_fd, limit)) {
+            continue;
+        }
+
+        frequency_ratio = std::min(frequency_ratio, static_cast<double>(current) / cpu.maximum);
+        // A higher limit means the baseline was read while already throttled, or the administrator has lifted a cap.
+        cpu.baseline = std::max(cpu.baseline, limit);
+        if (limit < cpu.baseline || (near_trip && current < cpu.baseline)) {
+            throttled = true;
+        }
+    }
+    _frequency_ratio = frequency_ratio;
+
+    if (throttled == _throttled) {
+        return false;
+    }
+
+    if (throttled) {
+        _throttle_events++;
+    }
+    _throttled = throttled;
+    return true;
+}
+
+bool ThrottleMonitor::throttled() const
+{
+    return _throttled;
+}
+
+size_t ThrottleMonitor::cpus() const
+{
+    return _cpus.size();
+}
+
+double ThrottleMonitor::frequencyRatio() const
+{
+    return _frequency_ratio;
+}
+
+std::chrono::milliseconds ThrottleMonitor::throttledTime() const
+{
+    return _throttled_time;
+}
+
+uint64_t ThrottleMonitor::throttleEvents() const
+{
+    return _throttle_events;
+}
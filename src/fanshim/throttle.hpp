@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+
+/**
+ * Returns the lowest passive, hot or critical trip point, in degrees celsius, of the thermal zone that `sensor` belongs to, or 0 if it has none (for example,
+ * because the sensor is not a thermal zone).
+ */
+double readTripPoint(const std::filesystem::path& sensor);
+
+/**
+ * Detects CPU frequency throttling from cpufreq.
+ *
+ * A CPU is throttled when its frequency limit (scaling_max_freq) drops below its baseline, which is how cpufreq cooling devices cap it. The baseline is
+ * the limit when monitoring starts, raised whenever a higher limit is seen, so a cap set by the administrator (for example with cpufreq-set) is not mistaken
+ * for throttling. A current frequency (scaling_cur_freq) below the baseline is only counted while a channel is near a trip point, because away from one it
+ * is usually the governor idling the CPU rather than the SoC protecting itself.
+ */
+class ThrottleMonitor
+{
+public:
+    ThrottleMonitor(const std::filesystem::path& sys_root);
+    ~ThrottleMonitor();
+
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    /**
+     * Samples every CPU at `now` and returns true if the throttled state changed.
+     */
+    bool sample(std::chrono::milliseconds now, bool near_trip);
+
+    bool throttled() const;
+    size_t cpus() const;
+
+    /**
+     * The lowest ratio of current to hardware maximum frequency across all CPUs at the last sample.
+     */
+    double frequencyRatio() const;
+
+    std::chrono::milliseconds throttledTime() const;
+    uint64_t throttleEvents() const;
+
+private:
+    ThrottleMonitor(const ThrottleMonitor&) = delete;
+    ThrottleMonitor(ThrottleMonitor&&) = delete;
+    ThrottleMonitor& operator=(const ThrottleMonitor&) = delete;
+    ThrottleMonitor& operator=(ThrottleMonitor&&) = delete;
+
+    struct CPU
+    {
+        int32_t current_fd;
+        int32_t limit_fd;
+        uint64_t maximum;
+        uint64_t baseline;
+    };
+
+    std::filesystem::path _sys_root;
+    std::vector<CPU> _cpus;
+    double _frequency_ratio;
+    std::chrono::milliseconds _last_sample;
+    std::chrono::milliseconds _throttled_time;
+    uint64_t _throttle_events;
+    bool _throttled;
+};
@@ -1,5 +1,6 @@
 #include "fanshim/driver.hpp"
 #include "fanshim/logger.hpp"
+#include "fanshim/stats.hpp"
 
 #include <signal.h>
 #include <spdlog/spdlog.h>
@@ -8,6 +9,11 @@
 #include <iostream>
 
 
+static void closeSignal(uv_signal_t* handle)
+{
+    uv_close(reinterpret_cast<uv_handle_t*>(handle), nullptr);
+}
+
 static void clearLoop()
 {
     uv_run(uv_default_loop(), UV_RUN_DEFAULT);
@@ -18,11 +24,6 @@ static void clearLoop()
     logger().warn("Event loop closed");
 }
 
-static void walkAndClose(uv_handle_t* handle, void* /* unused */)
-{
-    uv_close(handle, [](uv_handle_t* /* unused */) {});
-}
-
 static void onSignalReceived(uv_signal_t* handle, int32_t signal)
 {
     logger().warn("Signal received: {}", signal);
@@ -31,22 +32,19 @@ static void onSignalReceived(uv_signal_t* handle, int32_t signal)
         return;
     }
 
-    int32_t result = uv_loop_close(handle->loop);
-    if (result == UV_EBUSY) {
-        uv_stop(handle->loop);
-        uv_walk(handle->loop, walkAndClose, NULL);
-    }
+    // The signal handles do not keep the loop alive, so run() returns once the driver's handles are closed.
+    static_cast<Driver*>(handle->data)->close(nullptr);
 }
 
 int main(int argc, char** argv)
 {
-    uv_signal_t sigint;
-    uv_signal_init(uv_default_loop(), &sigint);
-    uv_signal_start(&sigint, onSignalReceived, SIGINT);
+    StartupTimeline& startup = startupTimeline();
+    logger().info("Fanshim driver starting");
+    startup.mark(StartupPhase::LOGGER);
 
     Configuration config;
 
-    logger().warn("Driver configuration loaded:[{}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}]",
+    logger().warn("Driver configuration loaded:[{}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}]",
                   "On Threshold",
                   config.onThreshold(),
                   "Off Threshold",
@@ -62,11 +60,75 @@ int main(int argc, char** argv)
                   "Output File",
                   config.outputFile().native(),
                   "Force File",
-                  config.forceFile().native());
+                  config.forceFile().native(),
+                  "Control Socket",
+                  config.controlSocket().native(),
+                  "Status Segment",
+                  config.statusSegment(),
+                  "Load Threshold",
+                  config.loadThreshold(),
+                  "Load Duration",
+                  config.loadDuration().count(),
+                  "Load Bias",
+                  config.loadBias(),
+                  "Proc Root",
+                  config.procRoot().native(),
+                  "RT Priority",
+                  config.rtPriority(),
+                  "RT CPU",
+                  config.rtCPU(),
+                  "RT Lock Memory",
+                  config.rtLockMemory(),
+                  "PWM Frequency",
+                  config.pwmFrequency(),
+                  "Min On Time",
+                  config.minOnTime().count(),
+                  "Min Off Time",
+                  config.minOffTime().count());
+
+    for (const auto& channel : config.channels()) {
+        logger().warn("Channel configuration loaded:[{}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}, {}: {}]",
+                      "Name",
+                      channel.name,
+                      "Chip",
+                      channel.chip,
+                      "Fan Pin",
+                      channel.fan_pin,
+                      "Button Pin",
+                      channel.button_pin,
+                      "Clock Pin",
+                      channel.clock_pin,
+                      "Data Pin",
+                      channel.data_pin,
+                      "Sensor",
+                      channel.sensor.native(),
+                      "On Threshold",
+                      channel.on_threshold,
+                      "Off Threshold",
+                      channel.off_threshold,
+                      "Bands",
+                      channel.bands.size());
+    }
+    startup.mark(StartupPhase::CONFIGURATION);
 
     Driver driver(config);
 
+    // systemd stops the service with SIGTERM; both signals shut down through the loop, so destructors run and the buffered log is written.
+    uv_signal_t sigint;
+    uv_signal_init(uv_default_loop(), &sigint);
+    sigint.data = &driver;
+    uv_signal_start(&sigint, onSignalReceived, SIGINT);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&sigint));
+    uv_signal_t sigterm;
+    uv_signal_init(uv_default_loop(), &sigterm);
+    sigterm.data = &driver;
+    uv_signal_start(&sigterm, onSignalReceived, SIGTERM);
+    uv_unref(reinterpret_cast<uv_handle_t*>(&sigterm));
+
     driver.run();
+    closeSignal(&sigint);
+    closeSignal(&sigterm);
     clearLoop();
+    LoggingInterface::flush();
     return 0;
 }
@@ -0,0 +1,280 @@
+#include "fanshim/backend.hpp"
+#include "fanshim/clock.hpp"
+#include "fanshim/configuration.hpp"
+#include "fanshim/driver.hpp"
+#include "fanshim/logger.hpp"
+#include "fanshim/simulation.hpp"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/fmt/fmt.h>
+#include <stdlib.h>
+#include <uv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+using json = nlohmann::json;
+
+inline constexpr std::chrono::seconds DEFAULT_DURATION = std::chrono::hours(1);
+
+
+struct ChannelReport
+{
+    std::chrono::milliseconds fan_on;
+    std::chrono::milliseconds above_threshold;
+    double peak;
+};
+
+static void usage(const char* program)
+{
+    fprintf(stderr,
+            "Usage: %s [--config <file>] [--duration <s>] [--json] [--trace <file> | [--initial <C>] [--fan-off <C>] [--fan-on <C>] [--time-constant <s>]]\n",
+            program);
+}
+
+/**
+ * Copies the configuration with every host-facing output disabled, so that a simulation never touches the files, socket or segment of a running driver.
+ * The realtime worker is disabled too, since simulated time does not pass on its thread.
+ */
+static std::filesystem::path isolateConfiguration(const std::filesystem::path& configuration_file, const std::filesystem::path& workspace)
+{
+    json configuration = json::object();
+    std::ifstream stream(configuration_file);
+    if (stream) {
+        configuration = json::parse(stream);
+    }
+
+    configuration["output-file"] = "";
+    configuration["force-file"] = "";
+    configuration["control-socket"] = "";
+    configuration["status-segment"] = "";
+    configuration["rt-priority"] = 0;
+
+    // Throttling depends on the host's CPUs unless the configuration points at a prepared tree.
+    if (!configuration.contains("sys-root")) {
+        configuration["sys-root"] = (workspace / "sys").native();
+    }
+
+    std::filesystem::path isolated = workspace / "simulation.json";
+    std::ofstream(isolated) << configuration.dump();
+    return isolated;
+}
+
+static std::string formatDuration(std::chrono::milliseconds duration)
+{
+    auto hours = std::chrono::duration_cast<std::chrono::hours>(duration);
+    auto minutes = std::chrono::duration_cast<std::chrono::minutes>(duration - hours);
+    auto seconds = std::chrono::duration<double>(duration - hours - minutes);
+    return fmt::format("{}h {:02}m {:04.1f}s", hours.count(), minutes.count(), seconds.count());
+}
+
+static double percentage(std::chrono::milliseconds part, std::chrono::milliseconds whole)
+{
+    return whole.count() ? 100.0 * part.count() / whole.count() : 0.0;
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path configuration_file(DEFAULT_CONFIGURATION_FILE);
+    std::filesystem::path trace_file;
+    std::chrono::milliseconds duration(0);
+    ThermalParameters parameters = {DEFAULT_MODEL_INITIAL, DEFAULT_MODEL_FAN_OFF, DEFAULT_MODEL_FAN_ON, DEFAULT_MODEL_TIME_CONSTANT};
+    bool json_output = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view argument = argv[i];
+            bool has_value = i + 1 < argc;
+            if (argument == "--json") {
+                json_output = true;
+            }
+            else if (argument == "--config" && has_value) {
+                configuration_file = argv[++i];
+            }
+            else if (argument == "--trace" && has_value) {
+                trace_file = argv[++i];
+            }
+            else if (argument == "--duration" && has_value) {
+                duration = std::chrono::milliseconds(static_cast<int64_t>(std::stod(argv[++i]) * 1000));
+            }
+            else if (argument == "--initial" && has_value) {
+                parameters.initial = std::stod(argv[++i]);
+            }
+            else if (argument == "--fan-off" && has_value) {
+                parameters.fan_off = std::stod(argv[++i]);
+            }
+            else if (argument == "--fan-on" && has_value) {
+                parameters.fan_on = std::stod(argv[++i]);
+            }
+            else if (argument == "--time-constant" && has_value) {
+                parameters.time_constant = std::chrono::seconds(std::stoul(argv[++i]));
+            }
+            else {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    catch (const std::exception& ex) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::shared_ptr<const Trace> trace;
+    if (!trace_file.empty()) {
+        try {
+            trace = std::make_shared<const Trace>(loadTrace(trace_file));
+        }
+        catch (const std::exception& ex) {
+            fprintf(stderr, "%s\n", ex.what());
+            return 1;
+        }
+
+        if (duration.count() == 0) {
+            duration = trace->back().time - trace->front().time;
+        }
+    }
+
+    if (duration.count() == 0) {
+        duration = DEFAULT_DURATION;
+    }
+
+    char workspace_template[] = "/tmp/fanshim_sim.XXXXXX";
+    if (!mkdtemp(workspace_template)) {
+        perror("Failed to create simulation workspace");
+        return 1;
+    }
+    std::filesystem::path workspace(workspace_template);
+
+    // Unless asked otherwise, keep the simulation out of the system log; a simulated day would otherwise rotate it many times over.
+    std::string log_file = (workspace / "simulation.log").native();
+    if (!getenv("SHIM_LOG_FILE")) {
+        setenv("SHIM_LOG_FILE", log_file.c_str(), 1);
+    }
+    if (!getenv("SHIM_LOG_LEVEL")) {
+        logger().setLevel(LogLevel::ERROR);
+    }
+
+    std::filesystem::path isolated;
+    try {
+        isolated = isolateConfiguration(configuration_file, workspace);
+    }
+    catch (const std::exception& ex) {
+        fprintf(stderr, "Failed to read configuration %s: %s\n", configuration_file.c_str(), ex.what());
+        return 1;
+    }
+
+    Configuration configuration(isolated);
+    VirtualClock clock;
+    uv_loop_t loop;
+    uv_loop_init(&loop);
+
+    std::vector<ScriptedTemperature*> temperatures;
+    TemperatureSource::Factory sensor_factory = [&](const ChannelConfiguration& /* unused */) -> std::unique_ptr<TemperatureSource> {
+        std::unique_ptr<ScriptedTemperature> temperature;
+        if (trace) {
+            temperature = std::make_unique<TraceTemperature>(trace, temperatures.size());
+        }
+        else {
+            temperature = std::make_unique<ThermalModel>(parameters);
+        }
+        temperatures.push_back(temperature.get());
+        return temperature;
+    };
+
+    Driver driver(configuration, &loop, SimulatedBackend::create, &clock, sensor_factory);
+    const auto& channels = driver.channels();
+
+    std::vector<ChannelReport> reports(channels.size(), ChannelReport{std::chrono::milliseconds(0), std::chrono::milliseconds(0), 0.0});
+    for (size_t i = 0; i < channels.size(); ++i) {
+        reports[i].peak = temperatures[i]->temperature();
+    }
+
+    // The fan only changes inside timer callbacks, so between two wakeups each channel's fan state is constant and its temperature can be advanced exactly.
+    auto advance = [&](std::chrono::milliseconds elapsed) {
+        for (size_t i = 0; i < channels.size(); ++i) {
+            bool fan = channels[i]->fan();
+            double temperature = temperatures[i]->temperature();
+
+            if (fan) {
+                reports[i].fan_on += elapsed;
+            }
+            if (temperature >= channels[i]->configuration().on_threshold) {
+                reports[i].above_threshold += elapsed;
+            }
+
+            temperatures[i]->advance(elapsed, fan);
+            reports[i].peak = std::max({reports[i].peak, temperature, temperatures[i]->temperature()});
+        }
+    };
+
+    auto wall_start = std::chrono::steady_clock::now();
+    uint64_t end = static_cast<uint64_t>(duration.count());
+
+    driver.start();
+    for (;;) {
+        uint64_t next = std::min(clock.nextDue(), end);
+        advance(std::chrono::milliseconds(next - clock.now()));
+        if (clock.nextDue() > end) {
+            clock.runUntil(end);
+            break;
+        }
+        clock.runNext();
+    }
+
+    auto wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start);
+
+    if (json_output) {
+        json report = {
+            {"simulated_s", std::chrono::duration<double>(duration).count()},
+            {"wall_s", wall_time.count()},
+            {"wakeups", clock.wakeups()},
+            {"callbacks", clock.callbacks()},
+            {"channels", json::array()},
+        };
+
+        for (size_t i = 0; i < channels.size(); ++i) {
+            report["channels"].push_back({
+                {"name", channels[i]->name()},
+                {"temperature_reads", channels[i]->stats().temperature_reads},
+                {"fan_transitions", channels[i]->stats().fan_transitions},
+                {"fan_on_s", std::chrono::duration<double>(reports[i].fan_on).count()},
+                {"above_threshold_s", std::chrono::duration<double>(reports[i].above_threshold).count()},
+                {"peak_temperature", reports[i].peak},
+            });
+        }
+        fmt::print("{}\n", report.dump());
+    }
+    else {
+        fmt::print("Simulated {} in {:.3f} s ({} wakeups, {} timer callbacks)\n", formatDuration(duration), wall_time.count(), clock.wakeups(), clock.callbacks());
+        fmt::print("{:<16} {:>10} {:>12} {:>10} {:>16} {:>8}\n", "channel", "reads", "transitions", "fan on", "above threshold", "peak");
+        for (size_t i = 0; i < channels.size(); ++i) {
+            fmt::print("{:<16} {:>10} {:>12} {:>9.1f}% {:>15.1f}% {:>8.1f}\n",
+                       channels[i]->name(),
+                       channels[i]->stats().temperature_reads,
+                       channels[i]->stats().fan_transitions,
+                       percentage(reports[i].fan_on, duration),
+                       percentage(reports[i].above_threshold, duration),
+                       reports[i].peak);
+        }
+    }
+
+    driver.close(nullptr);
+    uv_run(&loop, UV_RUN_DEFAULT);
+    uv_loop_close(&loop);
+    LoggingInterface::flush();
+
+    std::error_code ec;
+    std::filesystem::remove_all(workspace, ec);
+    return 0;
+}